@@ -7,6 +7,18 @@
 #include <pthread.h>
 #include <stdbool.h>
 #include <signal.h> // For sig_atomic_t
+#include <stdio.h>  // For FILE
+#include <sys/time.h> // For struct timeval
+
+// High-resolution wheel codes (1/120 of a detent), missing from older kernel headers
+#ifndef REL_WHEEL_HI_RES
+#define REL_WHEEL_HI_RES 0x0b
+#endif
+#ifndef REL_HWHEEL_HI_RES
+#define REL_HWHEEL_HI_RES 0x0c
+#endif
+#define WHEEL_HIRES_UNITS 120 // Hi-res wheel units per legacy detent
+#define POSITION_UNITS_PER_DETENT 40.0 // inertia_state.position moved by one wheel tick at unity sensitivity
 
 // Scroll direction enum
 typedef enum {
@@ -22,11 +34,20 @@ typedef enum {
 
 #define SCROLL_QUEUE_SIZE 64 // Adjust size as needed
 
+// State shared between threads is grouped by the thread that writes it and
+// each group starts on its own cache line, so one thread's stores never
+// invalidate a line the other thread is only reading
+#define CACHE_LINE_SIZE 64
+
 typedef struct {
-    int deltas[SCROLL_QUEUE_SIZE];
+    // Written by the input thread
+    _Alignas(CACHE_LINE_SIZE) int deltas[SCROLL_QUEUE_SIZE]; // In 1/WHEEL_HIRES_UNITS of a detent
+    double enqueue_times[SCROLL_QUEUE_SIZE]; // engine_clock_now() at enqueue
     int head;
-    int tail;
-    int count;
+    // Written by the inertia thread
+    _Alignas(CACHE_LINE_SIZE) int tail;
+    // Written by both, always together with the mutex
+    _Alignas(CACHE_LINE_SIZE) int count;
     pthread_mutex_t mutex;
     pthread_cond_t cond;
 } ScrollQueue;
@@ -49,12 +70,19 @@ extern double scroll_multiplier;   // How much the initial scroll is multiplied
 extern double scroll_friction;     // How quickly scrolling slows down (higher = faster stop)
 extern int auto_detect_direction;
 extern int use_multitouch;
-extern double current_velocity;    // Current scrolling velocity
-extern double current_position;    // Current scrolling position
+extern char *backend_name;         // Output backend override (NULL = from use_multitouch)
 extern double max_velocity_factor; // Maximum velocity as a factor of screen dimensions
 extern double sensitivity_divisor; // Divisor for sensitivity when using touchpad
 extern double resolution_multiplier; // Multiplier for virtual trackpad resolution
+extern double touch_surface_factor; // Virtual touch surface size relative to the screen
+#define MAX_TOUCH_SURFACE_FACTOR 64.0
+extern int touch_prearm;            // Touch down when a fling starts, in the same write as the first motion
+extern int touch_linger_ms;         // Keep the contact this long after a fling (0 = lift at once)
 extern int refresh_rate; // Refresh rate in Hz for inertia updates
+extern int min_refresh_rate; // Lowest frame rate the slow tail of a fling may drop to
+extern int display_sync;           // Lock frames to a multiple of the display refresh
+extern int physics_rate;           // Fixed physics steps per second, independent of frames
+extern double display_refresh_hz;  // Display refresh (0 = detect, stays 0 if unknown)
 extern char *device_override;      // Device path override
 extern int mouse_move_drag;        // Whether mouse movement should slow down scrolling
 
@@ -64,6 +92,41 @@ extern int num_app_exclusions;
 extern char current_active_app[256];
 extern pthread_mutex_t active_app_mutex;
 
+// Immutable snapshot of the tunables above plus the constants derived from
+// them (config_snapshot.c). The globals are the staging area written by the
+// config file and command line; threads read the published snapshot only.
+typedef struct {
+    unsigned long generation;     // Bumped by every config_publish()
+    ScrollDirection scroll_direction;
+    ScrollAxis scroll_axis;
+    int mouse_move_drag;
+    int refresh_rate;
+    int touch_linger_ms;
+    double scroll_multiplier;
+    double inertia_stop_threshold;
+    // Derived
+    double sensitivity_scale;     // scroll_sensitivity / sensitivity_divisor
+    double tick_velocity;         // Velocity added per wheel tick from idle
+    double tick_distance;         // Position moved per wheel tick
+    double max_velocity;          // Velocity cap along the scroll axis
+    double time_friction;         // Exponential decay rate of a fling, 1/s
+    double wheel_friction;        // Decay rate of the whole-detent wheel output, 1/s
+    double drag_friction_base;    // Mouse drag friction: base + per_unit * movement,
+    double drag_friction_per_unit; // capped at max
+    double drag_friction_max;
+    long frame_period_us;         // 1 / refresh_rate
+    long max_frame_period_us;     // 1 / min_refresh_rate, at least frame_period_us
+    double frame_phase_period;    // Seconds between display-locked frame slots (0 = free-running)
+    double physics_step;          // 1 / physics_rate
+} ConfigSnapshot;
+
+int config_publish(void);                     // Snapshot the globals; returns -1 if out of memory
+const ConfigSnapshot *config_read_lock(void); // Valid until the matching unlock; nests
+void config_read_unlock(void);
+double config_time_friction(void);           // Fling decay rate, 1/s
+double config_wheel_friction(void);          // Whole-detent wheel decay rate, 1/s
+void config_release(void);                    // Free the snapshot at shutdown
+
 // Helper to check if current app is excluded
 int is_current_app_excluded(void);
 
@@ -79,37 +142,152 @@ extern pthread_mutex_t state_mutex; // Defined in momentum_mouse.c
 // Condition variable for state changes (stop/friction signals, potentially inertia updates)
 extern pthread_cond_t state_cond; // Defined in momentum_mouse.c
 
-// Flags for communication between threads (protected by state_mutex)
-extern bool stop_requested; // Defined in momentum_mouse.c
-extern int pending_friction_magnitude; // Store magnitude for friction request // Defined in momentum_mouse.c
+// Physics state, written by the inertia engine (protected by state_mutex)
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) double velocity; // Current scrolling velocity
+    double position;                           // Current scrolling position
+    int active;
+    struct timeval last_time;                  // When the fling last advanced
+    unsigned long frames;                      // Physics steps since startup
+    unsigned long flings;                      // Flings started since startup
+} InertiaState;
+extern InertiaState inertia_state; // Defined in inertia_logic.c
+
+// Flags for communication between threads (protected by state_mutex), set
+// by the input and socket threads and cleared by the inertia engine
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) bool stop_requested;
+    int pending_friction_magnitude; // Store magnitude for friction request
+} InertiaSignals;
+extern InertiaSignals inertia_signals; // Defined in momentum_mouse.c
 
 // Thread IDs
 extern pthread_t input_thread_id; // Defined in momentum_mouse.c
 extern pthread_t inertia_thread_id; // Defined in momentum_mouse.c
 
-// Structure to track boundary reset information
-typedef struct {
-    struct timeval reset_time;
-    double reset_velocity;
-    double reset_position;
-    int reset_direction;
-} BoundaryResetInfo;
-
-extern BoundaryResetInfo boundary_reset_info;
-extern int boundary_reset_in_progress;
-extern struct timeval last_boundary_reset_time;
 extern double inertia_stop_threshold; // Velocity threshold below which inertia stops
 
+// Output backend: how momentum reaches the desktop. One backend is chosen at
+// startup and the inertia thread only ever calls through these pointers.
+typedef struct {
+    const char *name;
+    int (*setup)(void);                           // Create the virtual device(s)
+    void (*begin)(void);                          // A fling starts from idle
+    int (*frame)(double velocity, double dt);     // Emit one frame of motion
+    void (*end)(void);                            // The fling stopped
+    int (*passthrough)(struct input_event *ev);   // Forward an unconsumed source event
+    int (*flush)(void);                           // Write buffered passthrough frames;
+                                                  // returns frames still pending, -1 on error
+    void (*destroy)(void);                        // Tear down the virtual device(s)
+    double (*friction_coefficient)(void);         // Time-based friction for this output
+    long (*idle)(void);                           // Optional: deferred work while no fling runs;
+                                                  // returns ms until it is due again, -1 if none
+    double steps_per_position;                    // Output steps per position unit; paces adaptive
+                                                  // frames (0 = always emit at refresh_rate)
+} EmitterBackend;
+
+extern const EmitterBackend multitouch_backend;
+extern const EmitterBackend wheel_backend;
+extern const EmitterBackend hires_wheel_backend;
+extern const EmitterBackend null_backend;
+extern const EmitterBackend *emitter; // The selected backend
+
+extern const EmitterBackend record_backend;
+
+const EmitterBackend *find_emitter_backend(const char *name);
+void list_emitter_backends(FILE *out);
+
+// Emitter thread (emitter_thread.c): runs a backend's device writes on a
+// thread of their own. The inertia and input threads hand frames and
+// passthrough events over through lock-free single-producer rings, so a
+// slow uinput write never delays a physics step.
+extern int use_emitter_thread;
+const EmitterBackend *threaded_emitter_backend(const EmitterBackend *inner);
+
+// Record backend: keeps emitted frames in a ring (and optionally a file)
+// instead of writing to /dev/uinput, so the pipeline runs unprivileged
+typedef enum {
+    RECORD_BEGIN = 0,
+    RECORD_FRAME = 1,
+    RECORD_END = 2
+} RecordKind;
+
+typedef struct {
+    double time;      // engine_clock_now() when the frame was emitted
+    RecordKind kind;
+    double velocity;  // RECORD_FRAME only
+    double dt;        // RECORD_FRAME only
+} RecordedFrame;
+
+#define RECORD_RING_SIZE 4096
+
+extern char *record_file_path; // Also append frames to this file (NULL = ring only)
+
+// Readers must not race the inertia thread; read after it has stopped
+size_t record_frame_count(void);                           // Frames currently in the ring
+const RecordedFrame *record_get_frame(size_t index);       // 0 = oldest retained frame
+unsigned long record_overwritten_frames(void);             // Frames lost to ring wrap-around
+void record_reset(void);
+
+// Outbound frame queue for a non-blocking uinput fd (uinput_outbox.c).
+// Frames that hit EAGAIN or a short write are retried whole; scroll frames
+// coalesce; essential frames (touch-down/up, buttons) are never dropped
+// while the device keeps accepting writes.
+#define OUTBOX_EVENTS_MAX 256
+#define OUTBOX_FRAMES_MAX 32
+
+typedef enum {
+    OUTBOX_DROPPABLE = 0, // May be dropped when the queue is full
+    OUTBOX_COALESCE = 1,  // Scroll motion: merged with a queued frame of the same layout
+    OUTBOX_ESSENTIAL = 2  // Must be delivered: gesture start/end, buttons
+} OutboxFrameClass;
+
+typedef struct {
+    int start;            // Index of the first event in UinputOutbox.events
+    int count;            // Events in the frame, including SYN_REPORT
+    int written;          // Events the kernel already accepted
+    OutboxFrameClass cls;
+} OutboxFrame;
+
+typedef struct {
+    const char *name;
+    int fd;
+    struct input_event events[OUTBOX_EVENTS_MAX];
+    int event_count;
+    OutboxFrame frames[OUTBOX_FRAMES_MAX];
+    int frame_count;
+    unsigned long retries;           // Writes that hit EAGAIN or were short
+    unsigned long dropped;           // Frames given up
+    unsigned long essential_dropped; // Of those, essential frames turned away by a queue full of them
+    unsigned long coalesced;         // Frames merged into a queued one
+} UinputOutbox;
+
+void outbox_init(UinputOutbox *box, const char *name, int fd);
+int outbox_send(UinputOutbox *box, const struct input_event *events, int count, OutboxFrameClass cls);
+int outbox_queue(UinputOutbox *box, const struct input_event *events, int count,
+                 int already_written, OutboxFrameClass cls);
+int outbox_flush(UinputOutbox *box);     // Returns frames still pending, -1 on a hard error
+int outbox_pending(const UinputOutbox *box);
+void outbox_report(const UinputOutbox *box);
+
 // Original event emitter functions
 int setup_virtual_device(void);
 int emit_scroll_event(int value);
-int emit_passthrough_event(struct input_event *ev);
 void destroy_virtual_device(void);
 
+// Passthrough device mirroring the grabbed source mouse
+struct libevdev;
+int setup_passthrough_device(struct libevdev *source);
+int emit_passthrough_event(struct input_event *ev);
+int flush_passthrough_events(void); // Returns frames still waiting for the device, -1 on error
+void destroy_passthrough_device(void);
+
 // New multitouch emitter functions
 int setup_virtual_multitouch_device(void);
+void attach_multitouch_encoder(int fd); // Encode frames into fd without creating a device
 int emit_two_finger_scroll_event(int delta);
 void end_multitouch_gesture(void);
+long multitouch_gesture_gap_remaining_ms(void);
 void destroy_virtual_multitouch_device(void);
 
 // Inertia logic functions
@@ -118,12 +296,57 @@ void process_inertia(void);
 // void process_inertia_mt(void); // Removed - logic is now in inertia_thread_func
 void start_inertia(int initial_velocity);
 void stop_inertia(void);
-int is_inertia_active(void);
+double advance_inertia(double dt); // Caller holds state_mutex; returns distance moved
+
+// Timing of one pipeline stage, each sample in seconds
+typedef struct {
+    unsigned long count;
+    double last;   // Seconds
+    double max;
+    double total;
+} LatencyStats;
+
+void latency_stats_add(LatencyStats *stats, double seconds);
+void latency_stats_print(const char *stage, const LatencyStats *stats);
+
+// First-frame latency: from enqueuing the wheel tick that starts a fling to
+// the return of that fling's first emitted frame. Written by the inertia thread.
+extern LatencyStats first_frame_latency;
+// Time the inertia thread spends inside emitter->frame() per frame
+extern LatencyStats frame_call_time;
+// How far emitted frames land from their display-locked slot (display_sync);
+// a late timer wake-up is measured against the slot it was timed for
+extern LatencyStats frame_phase_error;
+
+void detect_display_refresh(void); // display_refresh.c: XRandR, else DRM EDID
+
+// Converts per-frame motion into whole output steps, carrying the fraction
+typedef struct {
+    double remainder;
+} ScrollIntegrator;
+
+int scroll_integrator_step(ScrollIntegrator *integrator, double velocity, double dt, double steps_per_position);
+void scroll_integrator_reset(ScrollIntegrator *integrator);
+int is_inertia_active(void); // Lock-free
+
+// Consistent copy of the physics state, read without taking state_mutex
+// and without ever blocking the inertia engine (seqlock)
+typedef struct {
+    double velocity;
+    double position;
+    int active;
+    unsigned long frames; // Physics steps since startup
+    unsigned long flings; // Flings started since startup
+} InertiaSnapshot;
+
+void inertia_snapshot(InertiaSnapshot *out);
 void apply_mouse_friction(int movement_magnitude);
 
 // Input capture functions
 int initialize_input_capture(const char *device_override);
 int capture_input_event(void);
+int input_capture_fd(void);      // The source device's fd, -1 if not open
+int read_input_events(void);     // Handle all queued source events; -1 on a read error
 void cleanup_input_capture(void);
 
 // System settings detection
@@ -143,9 +366,72 @@ char* find_device_by_name(const char *device_name);
 // Thread functions
 void* input_thread_func(void* arg);
 void* inertia_thread_func(void* arg);
+void wake_inertia_thread(void); // After posting a stop or friction request
+void inertia_engine_start(void);
+long inertia_cycle(bool frame_due); // One non-blocking engine pass; returns ms until idle() is due, -1 if never
+long inertia_frame_interval_us(void); // When the next frame of a running fling is due
+void inertia_engine_stop(void);  // Report timing and end a running gesture
+
+// Shutdown (momentum_mouse.c): SIGINT/SIGTERM are blocked in every thread
+// and read from a signalfd; request_shutdown() clears running and writes
+// shutdown_event_fd, which every blocking wait also watches
+extern int shutdown_event_fd;
+void request_shutdown(void);
+int read_shutdown_signal(int signal_fd); // Signal number read, 0 if none pending
+
+// Focus socket the window listener reports the active app to
+int open_focus_socket(void);
+void handle_focus_message(int fd);
+void close_focus_socket(int fd);
+
+// Real-time options (realtime.c) for the input, inertia, emitter and
+// event loop threads
+extern char *sched_policy_name; // other, fifo or deadline (NULL = other)
+extern int sched_priority;      // SCHED_FIFO priority
+extern char *cpu_affinity;      // CPU list for those threads, e.g. "2-3" (NULL = any)
+extern int lock_memory;         // mlockall() and prefault thread stacks
+extern int timer_slack_us;      // Per-thread timer slack (0 = kernel default)
+
+int realtime_setup_process(void); // Check the options and lock memory; -1 on a bad option
+void realtime_setup_thread(const char *role, long period_us, long runtime_us);
+void realtime_update_thread(long period_us, long runtime_us); // Follow a new frame period
+void realtime_report(void);
+
+typedef struct {
+    unsigned long checked;
+    unsigned long missed;
+} DeadlineStats;
+
+extern DeadlineStats frame_deadlines; // Frames started more than half a period late (inertia engine)
+extern DeadlineStats frame_slots;     // Display-locked frames over a quarter slot off the slot they were timed for
+extern DeadlineStats input_deadlines; // Wheel events handled a frame period or more after the kernel stamped them
+
+// Power profiles (power_profile.c): while on AC or on battery, a profile
+// replaces refresh_rate, min_refresh_rate and touch_linger_ms; a value of
+// -1 keeps the global setting
+typedef struct {
+    int refresh_rate;
+    int min_refresh_rate;   // Physics tick policy: equal to refresh_rate = fixed rate
+    int touch_linger_ms;    // Idle behavior: how long the contact outlives a fling
+} PowerProfile;
+
+extern char *power_profile_mode; // auto, ac, battery or off (NULL = auto)
+extern PowerProfile ac_profile;
+extern PowerProfile battery_profile;
+
+int power_profile_open(void);   // Apply the profile for the current power source; -1 on a bad mode
+int power_profile_fd(void);     // udev monitor to watch for power changes, -1 if none
+void power_profile_handle(void); // Read the monitor; republish the config if the source changed
+void power_profile_close(void);
+
+// Single-thread mode (event_loop.c): input, frames, focus changes and
+// signals all served from one epoll loop on the main thread
+extern int single_thread_mode;
+int run_event_loop(int signal_fd);
+double engine_clock_now(void); // Monotonic seconds, the clock frames are timestamped with
 
-// Function to reset finger positions (used by inertia thread after boundary)
+// Finger position helpers for the multitouch emitter
 void reset_finger_positions(void);
-void jump_finger_positions(int delta); // New function for boundary jump
+void jump_finger_positions(ScrollAxis axis, int delta); // Move fingers to the opposite edge at a boundary
 
 #endif
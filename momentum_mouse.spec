@@ -13,6 +13,7 @@ BuildRequires:  make
 BuildRequires:  systemd-devel
 BuildRequires:  libevdev-devel
 BuildRequires:  libX11-devel
+BuildRequires:  libXrandr-devel
 BuildRequires:  gtk3-devel
 BuildRequires:  systemd-rpm-macros
 
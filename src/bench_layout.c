@@ -0,0 +1,194 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "momentum_mouse.h"
+
+// Shows what sharing a cache line between threads costs. Each case runs
+// twice: once with the fields packed the way separate globals can end up
+// next to each other, once with the cache-line-aligned layout the daemon
+// now uses. The two threads are pinned to different CPUs, so every store
+// to a shared line has to pull it over from the other core.
+//
+//   ./bench_layout [iterations] [cpu_a] [cpu_b]
+//
+// Pick one P-core and one E-core on a hybrid laptop to see the worst case.
+// "perf stat -e cache-misses" or "perf c2c" on top shows the traffic itself.
+
+int debug_mode = 0;
+
+static long iterations = 20000000;
+static int cpus[2] = {0, 1};
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void pin_to_cpu(int index) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpus[index], &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+        fprintf(stderr, "Could not pin to CPU %d, results may not cross cores\n", cpus[index]);
+    }
+}
+
+// --- Case 1: physics state vs. input signals, each written by one thread ---
+
+// How the old separate globals could lie: one line, two writers
+typedef struct {
+    double velocity;
+    double position;
+    int active;
+    bool stop_requested;
+    int pending_friction_magnitude;
+} PackedInertia;
+
+typedef struct {
+    volatile double *velocity;
+    volatile double *position;
+    volatile int *friction;
+    double seconds[2];
+} WriterCase;
+
+static void* physics_writer(void* arg) {
+    WriterCase *c = arg;
+    pin_to_cpu(0);
+    double start = now_seconds();
+    for (long i = 0; i < iterations; i++) {
+        *c->velocity = (double)i;
+        *c->position += 1.0;
+    }
+    c->seconds[0] = now_seconds() - start;
+    return NULL;
+}
+
+static void* input_writer(void* arg) {
+    WriterCase *c = arg;
+    pin_to_cpu(1);
+    double start = now_seconds();
+    for (long i = 0; i < iterations; i++) {
+        *c->friction = (int)i;
+    }
+    c->seconds[1] = now_seconds() - start;
+    return NULL;
+}
+
+static double run_writers(WriterCase *c) {
+    pthread_t a, b;
+    pthread_create(&a, NULL, physics_writer, c);
+    pthread_create(&b, NULL, input_writer, c);
+    pthread_join(a, NULL);
+    pthread_join(b, NULL);
+    return (c->seconds[0] + c->seconds[1]) / 2.0 / iterations * 1e9;
+}
+
+static void bench_writers(void) {
+    static PackedInertia packed;
+    static InertiaState state;
+    static InertiaSignals signals;
+
+    WriterCase before = { &packed.velocity, &packed.position, &packed.pending_friction_magnitude, {0, 0} };
+    WriterCase after = { &state.velocity, &state.position, &signals.pending_friction_magnitude, {0, 0} };
+    double ns_before = run_writers(&before);
+    double ns_after = run_writers(&after);
+    printf("physics vs. signals  packed %6.2f ns/store  split %6.2f ns/store  (%.1fx)\n",
+           ns_before, ns_after, ns_before / ns_after);
+}
+
+// --- Case 2: single-producer ring, head and tail written by different threads ---
+
+#define BENCH_RING_SIZE 256
+
+typedef struct {
+    atomic_uint head;
+    atomic_uint tail;
+} PackedIndices;
+
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) atomic_uint head;
+    _Alignas(CACHE_LINE_SIZE) atomic_uint tail;
+} SplitIndices;
+
+typedef struct {
+    atomic_uint *head;
+    atomic_uint *tail;
+    long ring[BENCH_RING_SIZE];
+    long sum;
+} RingCase;
+
+static void* ring_producer(void* arg) {
+    RingCase *c = arg;
+    pin_to_cpu(0);
+    for (long i = 0; i < iterations; i++) {
+        unsigned h = atomic_load_explicit(c->head, memory_order_relaxed);
+        while (h - atomic_load_explicit(c->tail, memory_order_acquire) >= BENCH_RING_SIZE) {
+            sched_yield();
+        }
+        c->ring[h & (BENCH_RING_SIZE - 1)] = i;
+        atomic_store_explicit(c->head, h + 1, memory_order_release);
+    }
+    return NULL;
+}
+
+static void* ring_consumer(void* arg) {
+    RingCase *c = arg;
+    pin_to_cpu(1);
+    for (long received = 0; received < iterations; ) {
+        unsigned t = atomic_load_explicit(c->tail, memory_order_relaxed);
+        unsigned h = atomic_load_explicit(c->head, memory_order_acquire);
+        if (t == h) {
+            sched_yield();
+            continue;
+        }
+        for (; t != h; t++, received++) {
+            c->sum += c->ring[t & (BENCH_RING_SIZE - 1)];
+        }
+        atomic_store_explicit(c->tail, t, memory_order_release);
+    }
+    return NULL;
+}
+
+static double run_ring(RingCase *c) {
+    pthread_t a, b;
+    double start = now_seconds();
+    pthread_create(&a, NULL, ring_producer, c);
+    pthread_create(&b, NULL, ring_consumer, c);
+    pthread_join(a, NULL);
+    pthread_join(b, NULL);
+    return (now_seconds() - start) / iterations * 1e9;
+}
+
+static void bench_ring(void) {
+    static PackedIndices packed;
+    static SplitIndices split;
+    static RingCase before, after;
+
+    before.head = &packed.head;
+    before.tail = &packed.tail;
+    after.head = &split.head;
+    after.tail = &split.tail;
+    double ns_before = run_ring(&before);
+    double ns_after = run_ring(&after);
+    printf("ring head vs. tail   packed %6.2f ns/item   split %6.2f ns/item   (%.1fx)\n",
+           ns_before, ns_after, ns_before / ns_after);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc > 1) iterations = atol(argv[1]);
+    if (argc > 2) cpus[0] = atoi(argv[2]);
+    if (argc > 3) cpus[1] = atoi(argv[3]);
+    if (iterations <= 0) {
+        fprintf(stderr, "Usage: %s [iterations] [cpu_a] [cpu_b]\n", argv[0]);
+        return 1;
+    }
+    printf("False sharing, %ld iterations, threads on CPU %d and %d\n", iterations, cpus[0], cpus[1]);
+    bench_writers();
+    bench_ring();
+    return 0;
+}
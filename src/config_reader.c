@@ -3,6 +3,37 @@
 #include <string.h>
 #include "momentum_mouse.h"
 
+// Keys of the AC and battery profiles: ac_refresh_rate, battery_min_refresh_rate,
+// ... Returns 1 if k was one of them
+static int parse_power_profile_key(const char *k, const char *value) {
+    PowerProfile *profile;
+    const char *field;
+    if (strncmp(k, "ac_", 3) == 0) {
+        profile = &ac_profile;
+        field = k + 3;
+    } else if (strncmp(k, "battery_", 8) == 0) {
+        profile = &battery_profile;
+        field = k + 8;
+    } else {
+        return 0;
+    }
+
+    int val = atoi(value);
+    if (strcmp(field, "refresh_rate") == 0) {
+        if (val > 0) profile->refresh_rate = val;
+    } else if (strcmp(field, "min_refresh_rate") == 0) {
+        if (val > 0) profile->min_refresh_rate = val;
+    } else if (strcmp(field, "touch_linger_ms") == 0) {
+        if (val >= 0) profile->touch_linger_ms = val;
+    } else {
+        return 0;
+    }
+    if (debug_mode) {
+        printf("Config: %s=%s\n", k, value);
+    }
+    return 1;
+}
+
 // Load configuration from the specified file
 void load_config_file(const char *filename) {
     FILE *fp = fopen(filename, "r");
@@ -150,6 +181,22 @@ void load_config_file(const char *filename) {
                         printf("Config: multitouch=false\n");
                     }
                 }
+            } else if (strcmp(k, "backend") == 0) {
+                if (strlen(value) > 0) {
+                    free(backend_name);
+                    backend_name = strdup(value);
+                    if (debug_mode) {
+                        printf("Config: backend=%s\n", value);
+                    }
+                }
+            } else if (strcmp(k, "record_file") == 0) {
+                if (strlen(value) > 0) {
+                    free(record_file_path);
+                    record_file_path = strdup(value);
+                    if (debug_mode) {
+                        printf("Config: record_file=%s\n", value);
+                    }
+                }
             } else if (strcmp(k, "horizontal") == 0) {
                 if (strcmp(value, "true") == 0 || strcmp(value, "1") == 0) {
                     scroll_axis = SCROLL_AXIS_HORIZONTAL;
@@ -193,6 +240,58 @@ void load_config_file(const char *filename) {
                         printf("Config: resolution_multiplier=%.2f\n", resolution_multiplier);
                     }
                 }
+            } else if (strcmp(k, "touch_surface_factor") == 0) {
+                double val = atof(value);
+                if (val >= 1.0 && val <= MAX_TOUCH_SURFACE_FACTOR) {
+                    touch_surface_factor = val;
+                    if (debug_mode) {
+                        printf("Config: touch_surface_factor=%.2f\n", touch_surface_factor);
+                    }
+                }
+            } else if (strcmp(k, "touch_prearm") == 0) {
+                if (strcmp(value, "true") == 0 || strcmp(value, "1") == 0) {
+                    touch_prearm = 1;
+                    if (debug_mode) {
+                        printf("Config: touch_prearm=true\n");
+                    }
+                } else if (strcmp(value, "false") == 0 || strcmp(value, "0") == 0) {
+                    touch_prearm = 0;
+                    if (debug_mode) {
+                        printf("Config: touch_prearm=false\n");
+                    }
+                }
+            } else if (strcmp(k, "touch_linger_ms") == 0) {
+                int val = atoi(value);
+                if (val >= 0) {
+                    touch_linger_ms = val;
+                    if (debug_mode) {
+                        printf("Config: touch_linger_ms=%d\n", touch_linger_ms);
+                    }
+                }
+            } else if (strcmp(k, "single_thread") == 0) {
+                if (strcmp(value, "true") == 0 || strcmp(value, "1") == 0) {
+                    single_thread_mode = 1;
+                    if (debug_mode) {
+                        printf("Config: single_thread=true\n");
+                    }
+                } else if (strcmp(value, "false") == 0 || strcmp(value, "0") == 0) {
+                    single_thread_mode = 0;
+                    if (debug_mode) {
+                        printf("Config: single_thread=false\n");
+                    }
+                }
+            } else if (strcmp(k, "emitter_thread") == 0) {
+                if (strcmp(value, "true") == 0 || strcmp(value, "1") == 0) {
+                    use_emitter_thread = 1;
+                    if (debug_mode) {
+                        printf("Config: emitter_thread=true\n");
+                    }
+                } else if (strcmp(value, "false") == 0 || strcmp(value, "0") == 0) {
+                    use_emitter_thread = 0;
+                    if (debug_mode) {
+                        printf("Config: emitter_thread=false\n");
+                    }
+                }
             } else if (strcmp(k, "inertia_stop_threshold") == 0) {
                 double val = atof(value);
                 if (val >= 0.0) { // Allow 0
@@ -201,6 +300,50 @@ void load_config_file(const char *filename) {
                         printf("Config: inertia_stop_threshold=%.2f\n", inertia_stop_threshold);
                     }
                 }
+            } else if (strcmp(k, "sched_policy") == 0) {
+                if (strlen(value) > 0) {
+                    free(sched_policy_name);
+                    sched_policy_name = strdup(value);
+                    if (debug_mode) {
+                        printf("Config: sched_policy=%s\n", value);
+                    }
+                }
+            } else if (strcmp(k, "sched_priority") == 0) {
+                int val = atoi(value);
+                if (val > 0) {
+                    sched_priority = val;
+                    if (debug_mode) {
+                        printf("Config: sched_priority=%d\n", sched_priority);
+                    }
+                }
+            } else if (strcmp(k, "cpu_affinity") == 0) {
+                if (strlen(value) > 0) {
+                    free(cpu_affinity);
+                    cpu_affinity = strdup(value);
+                    if (debug_mode) {
+                        printf("Config: cpu_affinity=%s\n", value);
+                    }
+                }
+            } else if (strcmp(k, "lock_memory") == 0) {
+                if (strcmp(value, "true") == 0 || strcmp(value, "1") == 0) {
+                    lock_memory = 1;
+                    if (debug_mode) {
+                        printf("Config: lock_memory=true\n");
+                    }
+                } else if (strcmp(value, "false") == 0 || strcmp(value, "0") == 0) {
+                    lock_memory = 0;
+                    if (debug_mode) {
+                        printf("Config: lock_memory=false\n");
+                    }
+                }
+            } else if (strcmp(k, "timer_slack_us") == 0) {
+                int val = atoi(value);
+                if (val >= 0) {
+                    timer_slack_us = val;
+                    if (debug_mode) {
+                        printf("Config: timer_slack_us=%d\n", timer_slack_us);
+                    }
+                }
             } else if (strcmp(k, "refresh_rate") == 0) {
                 int val = atoi(value);
                 if (val > 0) {
@@ -209,6 +352,52 @@ void load_config_file(const char *filename) {
                         printf("Config: refresh_rate=%d\n", refresh_rate);
                     }
                 }
+            } else if (strcmp(k, "min_refresh_rate") == 0) {
+                int val = atoi(value);
+                if (val > 0) {
+                    min_refresh_rate = val;
+                    if (debug_mode) {
+                        printf("Config: min_refresh_rate=%d\n", min_refresh_rate);
+                    }
+                }
+            } else if (strcmp(k, "physics_rate") == 0) {
+                int val = atoi(value);
+                if (val > 0) {
+                    physics_rate = val;
+                    if (debug_mode) {
+                        printf("Config: physics_rate=%d\n", physics_rate);
+                    }
+                }
+            } else if (strcmp(k, "display_sync") == 0) {
+                if (strcmp(value, "true") == 0 || strcmp(value, "1") == 0) {
+                    display_sync = 1;
+                    if (debug_mode) {
+                        printf("Config: display_sync=true\n");
+                    }
+                } else if (strcmp(value, "false") == 0 || strcmp(value, "0") == 0) {
+                    display_sync = 0;
+                    if (debug_mode) {
+                        printf("Config: display_sync=false\n");
+                    }
+                }
+            } else if (strcmp(k, "display_refresh_rate") == 0) {
+                double val = atof(value);
+                if (val > 0.0) {
+                    display_refresh_hz = val;
+                    if (debug_mode) {
+                        printf("Config: display_refresh_rate=%.3f\n", display_refresh_hz);
+                    }
+                }
+            } else if (strcmp(k, "power_profile") == 0) {
+                if (strlen(value) > 0) {
+                    free(power_profile_mode);
+                    power_profile_mode = strdup(value);
+                    if (debug_mode) {
+                        printf("Config: power_profile=%s\n", value);
+                    }
+                }
+            } else if (parse_power_profile_key(k, value)) {
+                // AC or battery profile value
             } else if (strcmp(k, "inertia_stop_threshold") == 0) {
                 double val = atof(value);
                 if (val >= 0.0) { // Allow 0
@@ -0,0 +1,153 @@
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "momentum_mouse.h"
+
+// Immutable configuration snapshots. The tunables in momentum_mouse.h are
+// only written while loading the config file and parsing the command line;
+// config_publish() then freezes them, together with the constants derived
+// from them, into a snapshot that the hot paths read through
+// config_read_lock(). Publishing swaps one pointer, so a reader sees either
+// the old snapshot or the new one and never a mix of both.
+//
+// Reclamation is RCU-style: readers announce themselves in one of two
+// counters picked by the current phase. The publisher flips the phase and
+// waits for the old counter to drain, twice, after which no reader can
+// still hold the old snapshot and it is freed.
+
+extern int screen_width;
+extern int screen_height;
+
+static _Atomic(ConfigSnapshot *) current_config = NULL;
+static atomic_uint config_phase;
+static atomic_uint config_readers[2];
+static pthread_mutex_t publish_mutex = PTHREAD_MUTEX_INITIALIZER;
+static unsigned long config_generation = 0; // Under publish_mutex
+
+// Per-thread read-side state; nested sections share the outermost snapshot
+static __thread const ConfigSnapshot *read_snapshot = NULL;
+static __thread unsigned read_slot;
+static __thread int read_depth = 0;
+
+const ConfigSnapshot *config_read_lock(void) {
+    if (read_depth++ > 0) {
+        return read_snapshot;
+    }
+    read_slot = atomic_load(&config_phase) & 1;
+    atomic_fetch_add(&config_readers[read_slot], 1);
+    read_snapshot = atomic_load(&current_config);
+    return read_snapshot;
+}
+
+void config_read_unlock(void) {
+    if (--read_depth > 0) {
+        return;
+    }
+    read_snapshot = NULL;
+    atomic_fetch_sub(&config_readers[read_slot], 1);
+}
+
+// Wait until every reader that could have seen the previous snapshot left
+static void wait_for_config_readers(void) {
+    for (int flip = 0; flip < 2; flip++) {
+        unsigned old_slot = atomic_fetch_xor(&config_phase, 1) & 1;
+        while (atomic_load(&config_readers[old_slot]) != 0) {
+            usleep(100);
+        }
+    }
+}
+
+int config_publish(void) {
+    ConfigSnapshot *next = calloc(1, sizeof(*next));
+    if (!next) {
+        perror("Failed to allocate configuration snapshot");
+        return -1;
+    }
+
+    next->scroll_direction = scroll_direction;
+    next->scroll_axis = scroll_axis;
+    next->mouse_move_drag = mouse_move_drag;
+    next->refresh_rate = refresh_rate > 0 ? refresh_rate : 200;
+    next->touch_linger_ms = touch_linger_ms;
+    next->scroll_multiplier = scroll_multiplier;
+    next->inertia_stop_threshold = inertia_stop_threshold;
+
+    // Derived once here instead of on every tick and frame
+    double friction_scale = scroll_friction / sqrt(scroll_sensitivity);
+    next->sensitivity_scale = scroll_sensitivity / sensitivity_divisor;
+    next->tick_velocity = 60.0 * next->sensitivity_scale;
+    next->tick_distance = POSITION_UNITS_PER_DETENT * next->sensitivity_scale;
+    next->max_velocity = (scroll_axis == SCROLL_AXIS_VERTICAL ? screen_height : screen_width) *
+                         max_velocity_factor;
+    next->time_friction = 0.6 * friction_scale;
+    next->wheel_friction = 2.0 * scroll_friction;
+    next->drag_friction_base = 0.01 * friction_scale;
+    next->drag_friction_per_unit = 0.0001 * friction_scale;
+    next->drag_friction_max = 0.05 * friction_scale;
+    next->physics_step = 1.0 / (physics_rate > 0 ? physics_rate : 1000);
+
+    // Locked to the display, the frame rate becomes the highest multiple
+    // of its refresh, or whole fraction below it, that does not exceed
+    // refresh_rate, so every refresh gets the same number of frames and no
+    // beat appears between the two
+    double frame_rate = next->refresh_rate;
+    if (display_sync && display_refresh_hz > 0.0) {
+        if (next->refresh_rate >= display_refresh_hz) {
+            frame_rate = display_refresh_hz * floor(next->refresh_rate / display_refresh_hz);
+        } else {
+            frame_rate = display_refresh_hz / ceil(display_refresh_hz / next->refresh_rate);
+        }
+        next->refresh_rate = (int)lround(frame_rate);
+        next->frame_phase_period = 1.0 / frame_rate;
+    }
+    next->frame_period_us = (long)(1000000.0 / frame_rate);
+    int min_rate = min_refresh_rate > 0 && min_refresh_rate < next->refresh_rate ? min_refresh_rate
+                                                                                 : next->refresh_rate;
+    next->max_frame_period_us = 1000000L / min_rate;
+    if (next->frame_phase_period > 0.0) {
+        // Whole frame slots only
+        double slots = floor(next->max_frame_period_us / (next->frame_phase_period * 1000000.0));
+        next->max_frame_period_us = (long)((slots > 1.0 ? slots : 1.0) * next->frame_phase_period * 1000000.0);
+    }
+
+    pthread_mutex_lock(&publish_mutex);
+    next->generation = ++config_generation;
+    ConfigSnapshot *old = atomic_exchange(&current_config, next);
+    if (old) {
+        wait_for_config_readers();
+        free(old);
+    }
+    if (debug_mode) {
+        printf("Config snapshot %lu: tick velocity %.2f, max velocity %.2f, friction %.3f, frame period %ld-%ld us\n",
+               next->generation, next->tick_velocity, next->max_velocity, next->time_friction,
+               next->frame_period_us, next->max_frame_period_us);
+    }
+    pthread_mutex_unlock(&publish_mutex);
+    return 0;
+}
+
+// Fling decay rate of the current snapshot, for the backends'
+// friction_coefficient() hooks (called inside advance_inertia's section)
+double config_time_friction(void) {
+    double friction = config_read_lock()->time_friction;
+    config_read_unlock();
+    return friction;
+}
+
+// Decay rate of the wheel backend, which has always stopped faster than
+// the position-based outputs and is not scaled by sensitivity
+double config_wheel_friction(void) {
+    double friction = config_read_lock()->wheel_friction;
+    config_read_unlock();
+    return friction;
+}
+
+// Only at shutdown, once no reader is left
+void config_release(void) {
+    pthread_mutex_lock(&publish_mutex);
+    free(atomic_exchange(&current_config, NULL));
+    pthread_mutex_unlock(&publish_mutex);
+}
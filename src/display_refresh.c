@@ -0,0 +1,163 @@
+#include <dirent.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <X11/Xlib.h>
+#include <X11/extensions/Xrandr.h>
+#include "momentum_mouse.h"
+
+// Display refresh detection for display_sync. XRandR reports the mode each
+// CRTC is actually driving; without an X server (a root service started
+// before login, or a Wayland session) the preferred timing in the EDID of a
+// connected DRM connector is used instead.
+
+#define DRM_SYSFS_PATH "/sys/class/drm"
+#define EDID_BLOCK_SIZE 128
+
+static double xrandr_mode_refresh(const XRRScreenResources *res, RRMode id) {
+    for (int i = 0; i < res->nmode; i++) {
+        const XRRModeInfo *mode = &res->modes[i];
+        if (mode->id != id) {
+            continue;
+        }
+        double v_total = mode->vTotal;
+        if (mode->modeFlags & RR_DoubleScan) v_total *= 2.0;
+        if (mode->modeFlags & RR_Interlace) v_total /= 2.0;
+        if (mode->hTotal == 0 || v_total <= 0.0) {
+            return 0.0;
+        }
+        return (double)mode->dotClock / (mode->hTotal * v_total);
+    }
+    return 0.0;
+}
+
+// Refresh of the primary output, or of the fastest active CRTC if no
+// output is primary
+static double xrandr_refresh(void) {
+    Display *display = XOpenDisplay(NULL);
+    if (!display) {
+        return 0.0;
+    }
+    Window root = DefaultRootWindow(display);
+    XRRScreenResources *res = XRRGetScreenResourcesCurrent(display, root);
+    if (!res) {
+        XCloseDisplay(display);
+        return 0.0;
+    }
+
+    RROutput primary = XRRGetOutputPrimary(display, root);
+    double primary_hz = 0.0;
+    double fastest_hz = 0.0;
+    for (int i = 0; i < res->ncrtc; i++) {
+        XRRCrtcInfo *crtc = XRRGetCrtcInfo(display, res, res->crtcs[i]);
+        if (!crtc) {
+            continue;
+        }
+        if (crtc->mode != None) {
+            double hz = xrandr_mode_refresh(res, crtc->mode);
+            for (int o = 0; o < crtc->noutput; o++) {
+                if (crtc->outputs[o] == primary) {
+                    primary_hz = hz;
+                }
+            }
+            if (hz > fastest_hz) {
+                fastest_hz = hz;
+            }
+        }
+        XRRFreeCrtcInfo(crtc);
+    }
+    XRRFreeScreenResources(res);
+    XCloseDisplay(display);
+    return primary_hz > 0.0 ? primary_hz : fastest_hz;
+}
+
+// First line of a sysfs attribute, without the newline
+static int read_sysfs_line(const char *dir, const char *attr, char *buf, size_t size) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", dir, attr);
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        return -1;
+    }
+    if (!fgets(buf, size, fp)) {
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+    buf[strcspn(buf, "\n")] = '\0';
+    return 0;
+}
+
+// Refresh of the first detailed timing descriptor, the preferred mode
+static double edid_preferred_refresh(const unsigned char *edid) {
+    const unsigned char *dtd = edid + 54;
+    double pixel_clock = (dtd[0] | dtd[1] << 8) * 10000.0;
+    int h_total = (dtd[2] | (dtd[4] & 0xf0) << 4) + (dtd[3] | (dtd[4] & 0x0f) << 8);
+    int v_total = (dtd[5] | (dtd[7] & 0xf0) << 4) + (dtd[6] | (dtd[7] & 0x0f) << 8);
+    if (pixel_clock <= 0.0 || h_total == 0 || v_total == 0) {
+        return 0.0;
+    }
+    return pixel_clock / ((double)h_total * v_total);
+}
+
+// Fastest preferred refresh among the connected, enabled connectors
+static double drm_refresh(void) {
+    DIR *dir = opendir(DRM_SYSFS_PATH);
+    if (!dir) {
+        return 0.0;
+    }
+    double fastest_hz = 0.0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        // Connectors are named cardN-<connector>, e.g. card0-eDP-1
+        if (strncmp(entry->d_name, "card", 4) != 0 || !strchr(entry->d_name, '-')) {
+            continue;
+        }
+        char connector[PATH_MAX];
+        char value[32];
+        snprintf(connector, sizeof(connector), "%s/%s", DRM_SYSFS_PATH, entry->d_name);
+        if (read_sysfs_line(connector, "status", value, sizeof(value)) < 0 || strcmp(value, "connected") != 0 ||
+            read_sysfs_line(connector, "enabled", value, sizeof(value)) < 0 || strcmp(value, "enabled") != 0) {
+            continue;
+        }
+
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "%s/edid", connector);
+        FILE *fp = fopen(path, "rb");
+        if (!fp) {
+            continue;
+        }
+        unsigned char edid[EDID_BLOCK_SIZE];
+        size_t got = fread(edid, 1, sizeof(edid), fp);
+        fclose(fp);
+        if (got == sizeof(edid)) {
+            double hz = edid_preferred_refresh(edid);
+            if (hz > fastest_hz) {
+                fastest_hz = hz;
+            }
+        }
+    }
+    closedir(dir);
+    return fastest_hz;
+}
+
+// Fill in display_refresh_hz unless it was set in the config or on the
+// command line. Leaves it at 0 if no display could be read.
+void detect_display_refresh(void) {
+    if (display_refresh_hz > 0.0) {
+        if (debug_mode) printf("Display refresh: %.3f Hz (configured)\n", display_refresh_hz);
+        return;
+    }
+    const char *source = "XRandR";
+    display_refresh_hz = xrandr_refresh();
+    if (display_refresh_hz <= 0.0) {
+        source = "DRM EDID";
+        display_refresh_hz = drm_refresh();
+    }
+    if (display_refresh_hz > 0.0) {
+        if (debug_mode) printf("Display refresh: %.3f Hz (%s)\n", display_refresh_hz, source);
+    } else {
+        display_refresh_hz = 0.0;
+        if (debug_mode) printf("Display refresh: unknown, frames are not locked to it\n");
+    }
+}
@@ -0,0 +1,79 @@
+#include <stdio.h>
+#include <string.h>
+#include "momentum_mouse.h"
+
+// Null backend: runs the whole input and physics pipeline but discards the
+// output. Useful to measure the daemon's own cost side by side with the
+// real backends, and to run without /dev/uinput.
+static unsigned long null_frames = 0;
+
+static int null_setup(void) {
+    null_frames = 0;
+    return 0;
+}
+
+static void null_begin(void) {
+}
+
+static int null_frame(double velocity, double dt) {
+    (void)velocity;
+    (void)dt;
+    null_frames++;
+    return 0;
+}
+
+static void null_end(void) {
+}
+
+static void null_destroy(void) {
+    if (debug_mode) {
+        printf("Null backend discarded %lu frames\n", null_frames);
+    }
+}
+
+// Same physics as the default multitouch output so timings are comparable
+static double null_friction_coefficient(void) {
+    return config_time_friction();
+}
+
+const EmitterBackend null_backend = {
+    .name = "null",
+    .setup = null_setup,
+    .begin = null_begin,
+    .frame = null_frame,
+    .end = null_end,
+    .passthrough = emit_passthrough_event,
+    .flush = flush_passthrough_events,
+    .destroy = null_destroy,
+    .friction_coefficient = null_friction_coefficient,
+    .steps_per_position = 1.0, // Paced like the multitouch output
+};
+
+// All selectable backends, the first one is the default
+static const EmitterBackend *const emitter_backends[] = {
+    &multitouch_backend,
+    &wheel_backend,
+    &hires_wheel_backend,
+    &null_backend,
+    &record_backend,
+};
+
+#define EMITTER_BACKEND_COUNT (sizeof(emitter_backends) / sizeof(emitter_backends[0]))
+
+const EmitterBackend *emitter = &multitouch_backend;
+
+// Look up a backend by name, NULL if there is no such backend
+const EmitterBackend *find_emitter_backend(const char *name) {
+    for (size_t i = 0; i < EMITTER_BACKEND_COUNT; i++) {
+        if (strcmp(emitter_backends[i]->name, name) == 0) {
+            return emitter_backends[i];
+        }
+    }
+    return NULL;
+}
+
+void list_emitter_backends(FILE *out) {
+    for (size_t i = 0; i < EMITTER_BACKEND_COUNT; i++) {
+        fprintf(out, "%s%s", i ? ", " : "", emitter_backends[i]->name);
+    }
+}
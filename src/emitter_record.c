@@ -0,0 +1,126 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "momentum_mouse.h"
+
+// Record backend: runs the whole pipeline without /dev/uinput. Every
+// begin/frame/end is kept in a ring buffer, timestamped with the engine
+// clock, and optionally appended to a text file for offline analysis.
+// Only the thread driving the backend writes to the ring.
+char *record_file_path = NULL;
+
+static RecordedFrame record_ring[RECORD_RING_SIZE];
+static size_t record_head = 0;   // Next slot to write
+static size_t record_count = 0;  // Valid frames in the ring
+static unsigned long record_overwritten = 0;
+static FILE *record_file = NULL;
+
+static const char *record_kind_name(RecordKind kind) {
+    switch (kind) {
+        case RECORD_BEGIN: return "begin";
+        case RECORD_FRAME: return "frame";
+        case RECORD_END:   return "end";
+    }
+    return "?";
+}
+
+static void record_push(RecordKind kind, double velocity, double dt) {
+    RecordedFrame *frame = &record_ring[record_head];
+    frame->time = engine_clock_now();
+    frame->kind = kind;
+    frame->velocity = velocity;
+    frame->dt = dt;
+
+    record_head = (record_head + 1) % RECORD_RING_SIZE;
+    if (record_count < RECORD_RING_SIZE) {
+        record_count++;
+    } else {
+        record_overwritten++;
+    }
+
+    if (record_file) {
+        fprintf(record_file, "%.6f %s %.4f %.6f\n",
+                frame->time, record_kind_name(kind), velocity, dt);
+    }
+}
+
+void record_reset(void) {
+    record_head = 0;
+    record_count = 0;
+    record_overwritten = 0;
+}
+
+size_t record_frame_count(void) {
+    return record_count;
+}
+
+const RecordedFrame *record_get_frame(size_t index) {
+    if (index >= record_count) {
+        return NULL;
+    }
+    size_t oldest = (record_head + RECORD_RING_SIZE - record_count) % RECORD_RING_SIZE;
+    return &record_ring[(oldest + index) % RECORD_RING_SIZE];
+}
+
+unsigned long record_overwritten_frames(void) {
+    return record_overwritten;
+}
+
+static int record_setup(void) {
+    record_reset();
+    if (record_file_path) {
+        record_file = fopen(record_file_path, "w");
+        if (!record_file) {
+            perror("Error opening record file");
+            return -1;
+        }
+        fprintf(record_file, "# time kind velocity dt\n");
+    }
+    if (debug_mode) {
+        printf("Record backend: ring of %d frames%s%s\n", RECORD_RING_SIZE,
+               record_file_path ? ", file " : "", record_file_path ? record_file_path : "");
+    }
+    return 0;
+}
+
+static void record_begin(void) {
+    record_push(RECORD_BEGIN, 0.0, 0.0);
+}
+
+static int record_frame(double velocity, double dt) {
+    record_push(RECORD_FRAME, velocity, dt);
+    return 0;
+}
+
+static void record_end(void) {
+    record_push(RECORD_END, 0.0, 0.0);
+}
+
+static void record_destroy(void) {
+    if (record_file) {
+        fclose(record_file);
+        record_file = NULL;
+    }
+    if (debug_mode) {
+        printf("Record backend: %zu frames in ring, %lu overwritten\n",
+               record_count, record_overwritten);
+    }
+}
+
+// Same physics as the default multitouch output so recordings are comparable
+static double record_friction_coefficient(void) {
+    return config_time_friction();
+}
+
+const EmitterBackend record_backend = {
+    .name = "record",
+    .setup = record_setup,
+    .begin = record_begin,
+    .frame = record_frame,
+    .end = record_end,
+    .passthrough = emit_passthrough_event,
+    .flush = flush_passthrough_events,
+    .destroy = record_destroy,
+    .friction_coefficient = record_friction_coefficient,
+    .steps_per_position = 1.0, // Paced like the multitouch output
+};
@@ -0,0 +1,336 @@
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "momentum_mouse.h"
+
+// Emitter thread: wraps the selected backend so that every device write
+// happens on one dedicated thread. The inertia thread produces begin/frame/end
+// commands and the input thread produces passthrough events, each into a
+// single-producer single-consumer ring, and neither ever waits on uinput.
+// The emitter thread drains both rings in order and owns all backend state.
+
+#define COMMAND_RING_SIZE 256       // Power of two
+#define PASSTHROUGH_RING_SIZE 1024  // Power of two
+#define RETRY_MS 2                  // Wake-up interval while the device is backed up
+#define IDLE_WAIT_MS 100
+#define PRODUCER_WAIT_MS 20         // How long begin/end and key frames wait for ring space
+#define PASSTHROUGH_FRAME_MAX 64    // Longest source frame, SYN_REPORT included
+
+typedef enum {
+    EMIT_BEGIN = 0,
+    EMIT_FRAME = 1,
+    EMIT_END = 2
+} EmitCommandKind;
+
+typedef struct {
+    EmitCommandKind kind;
+    double velocity;    // EMIT_FRAME only
+    double dt;          // EMIT_FRAME only
+    double produced_at; // engine_clock_now() when the inertia thread queued it
+} EmitCommand;
+
+// Head and tail run freely and wrap at UINT_MAX; the producer only writes
+// head and the consumer only writes tail, each on a cache line of its own
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) atomic_uint value;
+} RingIndex;
+
+static EmitCommand command_ring[COMMAND_RING_SIZE];
+static RingIndex command_head;
+static RingIndex command_tail;
+
+static struct input_event passthrough_ring[PASSTHROUGH_RING_SIZE];
+static RingIndex passthrough_head;
+static RingIndex passthrough_tail;
+
+// The source frame being read, input thread only. It enters the ring only
+// once its SYN_REPORT arrives, so the emitter thread never sees part of one.
+static struct input_event passthrough_frame[PASSTHROUGH_FRAME_MAX];
+static int passthrough_frame_len;
+static bool passthrough_frame_has_key;
+static bool passthrough_frame_overflow;
+
+static const EmitterBackend *inner_backend = NULL;
+static EmitterBackend threaded_backend;
+static pthread_t emitter_thread_id;
+static sem_t emitter_wake;
+static atomic_bool emitter_running;
+
+// Stage timing and losses; the stats are written by the emitter thread only
+static LatencyStats queue_wait_time;  // Queued until the emitter thread picked it up
+static LatencyStats frame_write_time; // Inside the inner backend's frame()
+static atomic_ulong dropped_frames;
+static atomic_ulong dropped_passthrough; // Whole source frames
+
+// Whether needed more slots are free
+static bool ring_has_room(atomic_uint *head, atomic_uint *tail, unsigned size, unsigned needed) {
+    unsigned h = atomic_load_explicit(head, memory_order_relaxed);
+    unsigned t = atomic_load_explicit(tail, memory_order_acquire);
+    return size - (h - t) >= needed;
+}
+
+// Wait a little for the emitter thread to make room; false if it never did
+static bool ring_wait_for_room(atomic_uint *head, atomic_uint *tail, unsigned size, unsigned needed) {
+    for (int waited_ms = 0; waited_ms < PRODUCER_WAIT_MS; waited_ms++) {
+        if (ring_has_room(head, tail, size, needed)) {
+            return true;
+        }
+        sem_post(&emitter_wake);
+        usleep(1000);
+    }
+    return ring_has_room(head, tail, size, needed);
+}
+
+static int push_command(EmitCommandKind kind, double velocity, double dt) {
+    if (!ring_has_room(&command_head.value, &command_tail.value, COMMAND_RING_SIZE, 1)) {
+        // A stale motion frame is not worth stalling physics for, but the
+        // gesture start and end must arrive
+        if (kind == EMIT_FRAME ||
+            !ring_wait_for_room(&command_head.value, &command_tail.value, COMMAND_RING_SIZE, 1)) {
+            atomic_fetch_add(&dropped_frames, 1);
+            return -1;
+        }
+    }
+    unsigned h = atomic_load_explicit(&command_head.value, memory_order_relaxed);
+    EmitCommand *cmd = &command_ring[h & (COMMAND_RING_SIZE - 1)];
+    cmd->kind = kind;
+    cmd->velocity = velocity;
+    cmd->dt = dt;
+    cmd->produced_at = engine_clock_now();
+    atomic_store_explicit(&command_head.value, h + 1, memory_order_release);
+    sem_post(&emitter_wake);
+    return 0;
+}
+
+static void threaded_begin(void) {
+    push_command(EMIT_BEGIN, 0.0, 0.0);
+}
+
+static int threaded_frame(double velocity, double dt) {
+    return push_command(EMIT_FRAME, velocity, dt);
+}
+
+static void threaded_end(void) {
+    push_command(EMIT_END, 0.0, 0.0);
+}
+
+static void reset_passthrough_frame(void) {
+    passthrough_frame_len = 0;
+    passthrough_frame_has_key = false;
+    passthrough_frame_overflow = false;
+}
+
+// Called by the input thread for every event; the thread is woken by flush()
+// once the batch is complete so a frame is written with a single writev.
+// Events are held until their SYN_REPORT and the frame then takes ring
+// space as a whole. With the ring full, a frame carrying a key or button
+// waits briefly for room; a motion-only frame is dropped whole, so the
+// device never sees a torn frame.
+static int threaded_passthrough(struct input_event *ev) {
+    if (ev->type == EV_SYN && ev->code == SYN_DROPPED) {
+        // The kernel dropped events; the open frame is no longer valid
+        reset_passthrough_frame();
+        return 0;
+    }
+    if (passthrough_frame_len == PASSTHROUGH_FRAME_MAX) {
+        passthrough_frame_overflow = true; // Dropped at its SYN_REPORT rather than split
+    } else {
+        passthrough_frame[passthrough_frame_len++] = *ev;
+    }
+    if (ev->type == EV_KEY) {
+        passthrough_frame_has_key = true;
+    }
+    if (ev->type != EV_SYN || ev->code != SYN_REPORT) {
+        return 0;
+    }
+
+    unsigned len = (unsigned)passthrough_frame_len;
+    bool has_key = passthrough_frame_has_key;
+    bool overflow = passthrough_frame_overflow;
+    reset_passthrough_frame();
+    // Skip frames that only carried events we consumed (e.g. a lone wheel tick)
+    if (len == 1 && !overflow) {
+        return 0;
+    }
+    if (overflow ||
+        (!ring_has_room(&passthrough_head.value, &passthrough_tail.value, PASSTHROUGH_RING_SIZE, len) &&
+         (!has_key ||
+          !ring_wait_for_room(&passthrough_head.value, &passthrough_tail.value, PASSTHROUGH_RING_SIZE, len)))) {
+        atomic_fetch_add(&dropped_passthrough, 1);
+        return -1;
+    }
+    unsigned h = atomic_load_explicit(&passthrough_head.value, memory_order_relaxed);
+    for (unsigned i = 0; i < len; i++) {
+        passthrough_ring[(h + i) & (PASSTHROUGH_RING_SIZE - 1)] = passthrough_frame[i];
+    }
+    atomic_store_explicit(&passthrough_head.value, h + len, memory_order_release);
+    return 0;
+}
+
+// Retrying held-back frames is the emitter thread's job, so the input
+// thread never has anything pending
+static int threaded_flush(void) {
+    sem_post(&emitter_wake);
+    return 0;
+}
+
+static void drain_passthrough(void) {
+    unsigned t = atomic_load_explicit(&passthrough_tail.value, memory_order_relaxed);
+    unsigned h = atomic_load_explicit(&passthrough_head.value, memory_order_acquire);
+    for (; t != h; t++) {
+        inner_backend->passthrough(&passthrough_ring[t & (PASSTHROUGH_RING_SIZE - 1)]);
+    }
+    atomic_store_explicit(&passthrough_tail.value, t, memory_order_release);
+}
+
+// Returns whether a fling is in progress after the drained commands
+static bool drain_commands(bool in_fling) {
+    unsigned t = atomic_load_explicit(&command_tail.value, memory_order_relaxed);
+    unsigned h = atomic_load_explicit(&command_head.value, memory_order_acquire);
+    for (; t != h; t++) {
+        EmitCommand cmd = command_ring[t & (COMMAND_RING_SIZE - 1)];
+        // Free the slot before the write so the producer never waits on it
+        atomic_store_explicit(&command_tail.value, t + 1, memory_order_release);
+
+        double start = engine_clock_now();
+        latency_stats_add(&queue_wait_time, start - cmd.produced_at);
+        switch (cmd.kind) {
+            case EMIT_BEGIN:
+                inner_backend->begin();
+                in_fling = true;
+                break;
+            case EMIT_FRAME:
+                if (inner_backend->frame(cmd.velocity, cmd.dt) < 0) {
+                    fprintf(stderr, "EmitterThread: Failed to emit %s frame.\n", inner_backend->name);
+                }
+                latency_stats_add(&frame_write_time, engine_clock_now() - start);
+                break;
+            case EMIT_END:
+                inner_backend->end();
+                in_fling = false;
+                break;
+        }
+    }
+    return in_fling;
+}
+
+// The thread starts in setup(), which the daemon runs before the first
+// config_publish() because the backend measures the screen the snapshot
+// needs. Until a snapshot exists the default frame rate stands in.
+static long snapshot_frame_period_us(void) {
+    const ConfigSnapshot *cfg = config_read_lock();
+    long period_us = cfg ? cfg->frame_period_us
+                         : 1000000L / (refresh_rate > 0 ? refresh_rate : 200);
+    config_read_unlock();
+    return period_us;
+}
+
+static void* emitter_thread_func(void* arg) {
+    (void)arg;
+    bool in_fling = false;
+    if (debug_mode) printf("Emitter thread started for %s backend.\n", inner_backend->name);
+    long period_us = snapshot_frame_period_us();
+    realtime_setup_thread("Emitter", period_us, period_us / 4);
+
+    while (atomic_load(&emitter_running)) {
+        period_us = snapshot_frame_period_us();
+        realtime_update_thread(period_us, period_us / 4);
+
+        // Passthrough first: button and motion frames from the source are
+        // older than any frame the physics produced since the last wake-up
+        drain_passthrough();
+        int pending = inner_backend->flush();
+        in_fling = drain_commands(in_fling);
+        long idle_ms = (!in_fling && inner_backend->idle) ? inner_backend->idle() : -1;
+
+        long wait_ms = pending > 0 ? RETRY_MS : IDLE_WAIT_MS;
+        if (idle_ms >= 0 && idle_ms < wait_ms) {
+            wait_ms = idle_ms > 0 ? idle_ms : 1;
+        }
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += wait_ms * 1000000L;
+        deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+        deadline.tv_nsec %= 1000000000L;
+        while (sem_timedwait(&emitter_wake, &deadline) < 0 && errno == EINTR) {
+        }
+    }
+
+    // Deliver whatever the producers queued before shutdown
+    drain_passthrough();
+    drain_commands(in_fling);
+    inner_backend->flush();
+    if (debug_mode) printf("Emitter thread exiting.\n");
+    return NULL;
+}
+
+static int threaded_setup(void) {
+    if (inner_backend->setup() < 0) {
+        return -1;
+    }
+    atomic_store(&command_head.value, 0);
+    atomic_store(&command_tail.value, 0);
+    atomic_store(&passthrough_head.value, 0);
+    atomic_store(&passthrough_tail.value, 0);
+    atomic_store(&dropped_frames, 0);
+    atomic_store(&dropped_passthrough, 0);
+    reset_passthrough_frame();
+    memset(&queue_wait_time, 0, sizeof(queue_wait_time));
+    memset(&frame_write_time, 0, sizeof(frame_write_time));
+
+    if (sem_init(&emitter_wake, 0, 0) < 0) {
+        perror("Emitter thread semaphore init failed");
+        inner_backend->destroy();
+        return -1;
+    }
+    atomic_store(&emitter_running, true);
+    if (pthread_create(&emitter_thread_id, NULL, emitter_thread_func, NULL) != 0) {
+        perror("Error creating emitter thread");
+        sem_destroy(&emitter_wake);
+        inner_backend->destroy();
+        return -1;
+    }
+    return 0;
+}
+
+// Producers must have stopped: the rings are drained one last time here
+static void threaded_destroy(void) {
+    atomic_store(&emitter_running, false);
+    sem_post(&emitter_wake);
+    pthread_join(emitter_thread_id, NULL);
+    sem_destroy(&emitter_wake);
+
+    if (debug_mode) {
+        latency_stats_print("Emitter queue wait", &queue_wait_time);
+        latency_stats_print("Emitter frame write", &frame_write_time);
+        unsigned long frames = atomic_load(&dropped_frames);
+        unsigned long passthrough = atomic_load(&dropped_passthrough);
+        if (frames || passthrough) {
+            printf("Emitter thread dropped %lu frames, %lu passthrough frames\n", frames, passthrough);
+        }
+    }
+    inner_backend->destroy();
+}
+
+const EmitterBackend *threaded_emitter_backend(const EmitterBackend *inner) {
+    inner_backend = inner;
+    threaded_backend = (EmitterBackend){
+        .name = inner->name,
+        .setup = threaded_setup,
+        .begin = threaded_begin,
+        .frame = threaded_frame,
+        .end = threaded_end,
+        .passthrough = threaded_passthrough,
+        .flush = threaded_flush,
+        .destroy = threaded_destroy,
+        .friction_coefficient = inner->friction_coefficient,
+        .steps_per_position = inner->steps_per_position,
+        .idle = NULL, // The emitter thread runs the inner idle() itself
+    };
+    return &threaded_backend;
+}
@@ -1,19 +1,40 @@
+#include <errno.h>
 #include <fcntl.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/uio.h>
 #include <linux/uinput.h>
+#include <libevdev-1.0/libevdev/libevdev-uinput.h>
 #include "momentum_mouse.h"
 
 // We'll store the uinput file descriptor here
 static int uinput_fd = -1;
+static UinputOutbox wheel_outbox; // Wheel frames the fd could not take yet
 
-int setup_virtual_device(void) {
+// Passthrough device cloned from the grabbed source mouse. Events that are
+// not consumed by momentum are buffered here; every completed SYN frame gets
+// one iovec and all completed frames are flushed with a single writev().
+#define PASSTHROUGH_BUFFER_MAX 256
+#define PASSTHROUGH_FRAMES_MAX 32
+static struct libevdev_uinput *passthrough_dev = NULL;
+static int passthrough_fd = -1;
+static struct input_event passthrough_events[PASSTHROUGH_BUFFER_MAX];
+static int passthrough_count = 0;       // Events buffered (complete frames + open frame)
+static int passthrough_frame_start = 0; // Index of the first event of the open frame
+static struct iovec passthrough_iov[PASSTHROUGH_FRAMES_MAX];
+static int passthrough_frames = 0;      // Completed frames waiting for writev
+static UinputOutbox passthrough_outbox; // Frames held back by backpressure, and drop counters
+
+// Create the virtual wheel mouse. The hi-res variant also advertises
+// REL_WHEEL_HI_RES/REL_HWHEEL_HI_RES so that clients see 1/120 detent steps.
+static int create_wheel_device(int hires) {
     uinput_fd = open("/dev/uinput", O_WRONLY | O_NONBLOCK);
     if (uinput_fd < 0) {
         perror("Error opening /dev/uinput");
         return -1;
     }
+    outbox_init(&wheel_outbox, "Wheel device", uinput_fd);
 
     // Enable relative events and specifically the REL_WHEEL event for scrolling
     if (ioctl(uinput_fd, UI_SET_EVBIT, EV_REL) < 0) {
@@ -29,6 +50,16 @@ int setup_virtual_device(void) {
         perror("Error setting REL_HWHEEL");
         return -1;
     }
+    if (hires) {
+        if (ioctl(uinput_fd, UI_SET_RELBIT, REL_WHEEL_HI_RES) < 0) {
+            perror("Error setting REL_WHEEL_HI_RES");
+            return -1;
+        }
+        if (ioctl(uinput_fd, UI_SET_RELBIT, REL_HWHEEL_HI_RES) < 0) {
+            perror("Error setting REL_HWHEEL_HI_RES");
+            return -1;
+        }
+    }
 
     // Prepare uinput device structure
     struct uinput_user_dev uidev;
@@ -50,64 +81,345 @@ int setup_virtual_device(void) {
     return 0;
 }
 
+int setup_virtual_device(void) {
+    return create_wheel_device(0);
+}
+
+// Write one wheel frame (events plus SYN_REPORT) with a single write().
+// Under backpressure the frame is queued and merged with later scroll.
+static int write_wheel_frame(struct input_event *frame, int count) {
+    memset(&frame[count], 0, sizeof(frame[count]));
+    frame[count].type = EV_SYN;
+    frame[count].code = SYN_REPORT;
+    count++;
+
+    if (outbox_send(&wheel_outbox, frame, count, OUTBOX_COALESCE) < 0) {
+        if (debug_mode) {
+            fprintf(stderr, "Error writing scroll event\n");
+        }
+        return -1;
+    }
+    return 0;
+}
+
 int emit_scroll_event(int value) {
-    struct input_event ev;
-    memset(&ev, 0, sizeof(ev));
-    
+    struct input_event frame[2];
+    memset(frame, 0, sizeof(frame));
+
     // Send the scroll event (REL_WHEEL or REL_HWHEEL based on scroll_axis)
-    ev.type = EV_REL;
-    ev.code = (scroll_axis == SCROLL_AXIS_HORIZONTAL) ? REL_HWHEEL : REL_WHEEL;
-    ev.value = value;  // value > 0 scrolls up/right, < 0 scrolls down/left
-    if (write(uinput_fd, &ev, sizeof(ev)) < 0) {
-        perror("Error writing scroll event");
+    frame[0].type = EV_REL;
+    frame[0].code = (config_read_lock()->scroll_axis == SCROLL_AXIS_HORIZONTAL) ? REL_HWHEEL : REL_WHEEL;
+    config_read_unlock();
+    frame[0].value = value;  // value > 0 scrolls up/right, < 0 scrolls down/left
+    return write_wheel_frame(frame, 1);
+}
+
+void destroy_virtual_device(void) {
+    outbox_flush(&wheel_outbox);
+    if (debug_mode) {
+        outbox_report(&wheel_outbox);
+    }
+    if (ioctl(uinput_fd, UI_DEV_DESTROY) < 0) {
+        perror("Error destroying uinput device");
+    }
+    close(uinput_fd);
+    uinput_fd = -1;
+}
+
+// --- Wheel backend ---
+// Emits whole REL_WHEEL detents; one detent per POSITION_UNITS_PER_DETENT of
+// fling distance, with the fraction carried by the shared integrator
+
+static ScrollIntegrator wheel_integrator;
+
+static void wheel_begin(void) {
+    scroll_integrator_reset(&wheel_integrator);
+}
+
+static int wheel_frame(double velocity, double dt) {
+    int value = scroll_integrator_step(&wheel_integrator, velocity, dt, 1.0 / POSITION_UNITS_PER_DETENT);
+    if (value == 0) {
+        return 0;
+    }
+    return emit_scroll_event(value);
+}
+
+static void wheel_end(void) {
+    scroll_integrator_reset(&wheel_integrator);
+}
+
+// Retry frames the device could not take during the fling
+static long wheel_idle(void) {
+    if (outbox_pending(&wheel_outbox) == 0) {
         return -1;
     }
-    
-    // Send a synchronization event so the OS processes the batch
-    memset(&ev, 0, sizeof(ev));
-    ev.type = EV_SYN;
-    ev.code = SYN_REPORT;
-    ev.value = 0;
-    if (write(uinput_fd, &ev, sizeof(ev)) < 0) {
-        perror("Error writing sync event");
+    return outbox_flush(&wheel_outbox) > 0 ? 1 : -1;
+}
+
+// Whole detents keep the wheel mode's own, faster decay
+static double wheel_friction_coefficient(void) {
+    return config_wheel_friction();
+}
+
+const EmitterBackend wheel_backend = {
+    .name = "wheel",
+    .setup = setup_virtual_device,
+    .begin = wheel_begin,
+    .frame = wheel_frame,
+    .end = wheel_end,
+    .passthrough = emit_passthrough_event,
+    .flush = flush_passthrough_events,
+    .destroy = destroy_virtual_device,
+    .friction_coefficient = wheel_friction_coefficient,
+    .idle = wheel_idle,
+    .steps_per_position = 1.0 / POSITION_UNITS_PER_DETENT,
+};
+
+// --- Hi-res wheel backend ---
+// Integrates the fling into REL_WHEEL_HI_RES units (1/120 detent) with the
+// shared integrator, so slow tails still move smoothly. Legacy REL_WHEEL
+// detents go out in the same frame whenever 120 hi-res units accumulate,
+// for clients that only understand whole clicks.
+
+#define HIRES_UNITS_PER_POSITION (WHEEL_HIRES_UNITS / POSITION_UNITS_PER_DETENT)
+
+static ScrollIntegrator hires_integrator;
+static int hires_detent_accum = 0;   // Hi-res units not yet reported as a legacy detent
+
+static int hires_wheel_setup(void) {
+    scroll_integrator_reset(&hires_integrator);
+    hires_detent_accum = 0;
+    return create_wheel_device(1);
+}
+
+static void hires_wheel_begin(void) {
+    scroll_integrator_reset(&hires_integrator);
+    hires_detent_accum = 0;
+}
+
+static int hires_wheel_frame(double velocity, double dt) {
+    int hires = scroll_integrator_step(&hires_integrator, velocity, dt, HIRES_UNITS_PER_POSITION);
+    if (hires == 0) {
+        return 0;
+    }
+
+    hires_detent_accum += hires;
+    int detents = hires_detent_accum / WHEEL_HIRES_UNITS;
+    hires_detent_accum -= detents * WHEEL_HIRES_UNITS;
+
+    struct input_event frame[3];
+    memset(frame, 0, sizeof(frame));
+    int horizontal = (config_read_lock()->scroll_axis == SCROLL_AXIS_HORIZONTAL);
+    config_read_unlock();
+    int count = 0;
+    frame[count].type = EV_REL;
+    frame[count].code = horizontal ? REL_HWHEEL_HI_RES : REL_WHEEL_HI_RES;
+    frame[count].value = hires;
+    count++;
+    if (detents != 0) {
+        frame[count].type = EV_REL;
+        frame[count].code = horizontal ? REL_HWHEEL : REL_WHEEL;
+        frame[count].value = detents;
+        count++;
+    }
+    return write_wheel_frame(frame, count);
+}
+
+// The fling is over; whatever did not add up to a unit or detent is dropped
+static void hires_wheel_end(void) {
+    scroll_integrator_reset(&hires_integrator);
+    hires_detent_accum = 0;
+}
+
+// Position-based like the touchpad output, so both share the same decay
+static double hires_wheel_friction_coefficient(void) {
+    return config_time_friction();
+}
+
+const EmitterBackend hires_wheel_backend = {
+    .name = "hires",
+    .setup = hires_wheel_setup,
+    .begin = hires_wheel_begin,
+    .frame = hires_wheel_frame,
+    .end = hires_wheel_end,
+    .passthrough = emit_passthrough_event,
+    .flush = flush_passthrough_events,
+    .destroy = destroy_virtual_device,
+    .friction_coefficient = hires_wheel_friction_coefficient,
+    .idle = wheel_idle,
+    .steps_per_position = HIRES_UNITS_PER_POSITION,
+};
+
+// Create a virtual device that mirrors every capability of the source mouse
+// (motion, buttons, extra keys, wheels). Used while the source is grabbed so
+// that everything momentum does not consume still reaches the desktop.
+int setup_passthrough_device(struct libevdev *source) {
+    int rc = libevdev_uinput_create_from_device(source, LIBEVDEV_UINPUT_OPEN_MANAGED, &passthrough_dev);
+    if (rc < 0) {
+        fprintf(stderr, "Error creating passthrough device: %s\n", strerror(-rc));
+        passthrough_dev = NULL;
         return -1;
     }
+    passthrough_fd = libevdev_uinput_get_fd(passthrough_dev);
+    outbox_init(&passthrough_outbox, "Passthrough device", passthrough_fd);
+    passthrough_count = 0;
+    passthrough_frame_start = 0;
+    passthrough_frames = 0;
+
+    if (debug_mode) {
+        printf("Passthrough device created: %s\n", libevdev_uinput_get_devnode(passthrough_dev));
+    }
     return 0;
 }
 
-// Pass through all non-scroll events from the original mouse
-int emit_passthrough_event(struct input_event *ev) {
-    // If grab_device is enabled, block all wheel events completely
-    if (grab_device && ev->type == EV_REL && (ev->code == REL_WHEEL || ev->code == REL_HWHEEL) && ev->value != 0) {
-        if (debug_mode) {
-            printf("Blocking wheel event (grab mode): type=%d, code=%d, value=%d\n", 
-                   ev->type, ev->code, ev->value);
+// Button and key frames must always arrive; pure relative motion can be
+// merged while the device is backed up; anything else may be dropped
+static OutboxFrameClass passthrough_frame_class(const struct input_event *events, int count) {
+    OutboxFrameClass cls = OUTBOX_COALESCE;
+    for (int i = 0; i < count; i++) {
+        if (events[i].type == EV_KEY) {
+            return OUTBOX_ESSENTIAL;
+        }
+        if (events[i].type != EV_REL && events[i].type != EV_SYN && events[i].type != EV_MSC) {
+            cls = OUTBOX_DROPPABLE;
         }
+    }
+    return cls;
+}
+
+// Hand completed frames from index first on to the outbox; the first one
+// may already be partly written
+static void queue_passthrough_frames(int first, int already_written) {
+    for (int i = first; i < passthrough_frames; i++) {
+        const struct input_event *events = passthrough_iov[i].iov_base;
+        int count = (int)(passthrough_iov[i].iov_len / sizeof(struct input_event));
+        outbox_queue(&passthrough_outbox, events, count, i == first ? already_written : 0,
+                     passthrough_frame_class(events, count));
+    }
+}
+
+// Write all completed frames with one writev(). uinput consumes each iovec
+// whole, so a short write tells us exactly which frames made it. Frames the
+// device could not take are queued in the outbox and retried on the next
+// flush, ahead of anything newer. Returns the number of frames still
+// waiting for the device, -1 on a write error.
+int flush_passthrough_events(void) {
+    if (passthrough_fd < 0) {
         return 0;
     }
-    
-    // Check if the file descriptor is valid
-    if (uinput_fd < 0) {
-        return -1;
+    if (outbox_pending(&passthrough_outbox) > 0) {
+        outbox_flush(&passthrough_outbox);
+    }
+    if (passthrough_frames == 0) {
+        return outbox_pending(&passthrough_outbox);
     }
-    
-    // Pass through all other events
-    if (write(uinput_fd, ev, sizeof(struct input_event)) < 0) {
-        // Only log errors for non-SYN events to reduce noise
-        // And don't log mouse movement errors to reduce spam
-        if (ev->type != EV_SYN && !(ev->type == EV_REL && (ev->code == REL_X || ev->code == REL_Y))) {
-            perror("Error writing passthrough event");
+
+    int result = 0;
+    if (outbox_pending(&passthrough_outbox) > 0) {
+        // Still backed up: queue behind the pending frames to keep order
+        queue_passthrough_frames(0, 0);
+    } else {
+        ssize_t total = 0;
+        for (int i = 0; i < passthrough_frames; i++) {
+            total += (ssize_t)passthrough_iov[i].iov_len;
+        }
+
+        ssize_t written = writev(passthrough_fd, passthrough_iov, passthrough_frames);
+        if (written < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            passthrough_outbox.dropped += passthrough_frames;
+            if (debug_mode) {
+                perror("Error writing passthrough frames");
+            }
+            result = -1;
+        } else if (written != total) {
+            int frames_written = 0;
+            ssize_t remaining = written > 0 ? written : 0;
+            while (frames_written < passthrough_frames &&
+                   remaining >= (ssize_t)passthrough_iov[frames_written].iov_len) {
+                remaining -= (ssize_t)passthrough_iov[frames_written].iov_len;
+                frames_written++;
+            }
+            passthrough_outbox.retries++;
+            queue_passthrough_frames(frames_written, (int)(remaining / (ssize_t)sizeof(struct input_event)));
         }
-        return -1;
     }
-    
+
+    // Keep the open (incomplete) frame, if any, at the start of the buffer
+    int open_events = passthrough_count - passthrough_frame_start;
+    if (open_events > 0 && passthrough_frame_start > 0) {
+        memmove(passthrough_events, &passthrough_events[passthrough_frame_start],
+                open_events * sizeof(struct input_event));
+    }
+    passthrough_count = open_events;
+    passthrough_frame_start = 0;
+    passthrough_frames = 0;
+    return result < 0 ? result : outbox_pending(&passthrough_outbox);
+}
+
+// Queue an event for the passthrough device. Events are buffered until the
+// SYN_REPORT that closes their frame; frames are written when the caller
+// flushes after draining the source, or when the buffer fills up.
+int emit_passthrough_event(struct input_event *ev) {
+    // Without a passthrough device the source is not grabbed and the
+    // desktop already receives its events natively.
+    if (passthrough_fd < 0) {
+        return 0;
+    }
+
+    if (ev->type == EV_SYN && ev->code == SYN_DROPPED) {
+        // The kernel dropped events; the open frame is no longer valid
+        passthrough_count = passthrough_frame_start;
+        return 0;
+    }
+
+    if (passthrough_count == PASSTHROUGH_BUFFER_MAX) {
+        if (passthrough_frames > 0) {
+            flush_passthrough_events();
+        }
+        if (passthrough_count == PASSTHROUGH_BUFFER_MAX) {
+            // A single frame larger than the buffer; drop it rather than split it
+            passthrough_count = 0;
+            passthrough_outbox.dropped++;
+            return -1;
+        }
+    }
+
+    passthrough_events[passthrough_count++] = *ev;
+
+    if (ev->type != EV_SYN || ev->code != SYN_REPORT) {
+        return 0;
+    }
+
+    // Skip frames that only carried events we consumed (e.g. a lone wheel tick)
+    int frame_len = passthrough_count - passthrough_frame_start;
+    if (frame_len == 1) {
+        passthrough_count = passthrough_frame_start;
+        return 0;
+    }
+
+    passthrough_iov[passthrough_frames].iov_base = &passthrough_events[passthrough_frame_start];
+    passthrough_iov[passthrough_frames].iov_len = frame_len * sizeof(struct input_event);
+    passthrough_frames++;
+    passthrough_frame_start = passthrough_count;
+
+    if (passthrough_frames == PASSTHROUGH_FRAMES_MAX) {
+        return flush_passthrough_events() < 0 ? -1 : 0;
+    }
     return 0;
 }
 
-void destroy_virtual_device(void) {
-    if (ioctl(uinput_fd, UI_DEV_DESTROY) < 0) {
-        perror("Error destroying uinput device");
+void destroy_passthrough_device(void) {
+    if (passthrough_dev) {
+        flush_passthrough_events();
+        outbox_flush(&passthrough_outbox);
+        if (debug_mode) {
+            outbox_report(&passthrough_outbox);
+        }
+        libevdev_uinput_destroy(passthrough_dev);
+        passthrough_dev = NULL;
     }
-    close(uinput_fd);
-    uinput_fd = -1;
+    passthrough_fd = -1;
+    passthrough_count = 0;
+    passthrough_frame_start = 0;
+    passthrough_frames = 0;
 }
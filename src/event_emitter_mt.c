@@ -1,37 +1,208 @@
 #include <fcntl.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <errno.h>
 #include <linux/uinput.h>
 #include <sys/time.h>
 #include <X11/Xlib.h>
 #include <math.h>
 #include "momentum_mouse.h"
 
-// External references to inertia logic variables
-extern double current_position;
-extern double current_velocity;
-
 // We'll store the uinput file descriptor for multitouch events here.
 static int uinput_mt_fd = -1;
 static int touch_active = 0;  // Track if touch is currently active
 static struct timeval last_gesture_end_time = {0, 0};
 static const int MIN_GESTURE_INTERVAL_MS = 50; // Reduced minimum time between gestures
-BoundaryResetInfo boundary_reset_info = {{0, 0}, 0.0, 0.0, 0};
-int boundary_reset_in_progress = 0;
-struct timeval last_boundary_reset_time = {0, 0};
+static int deferred_delta = 0; // Motion held back while a touch-down waits for the gesture gap
+static int touch_lingering = 0; // Fling ended but the contact is kept for the next one
+static struct timeval linger_until = {0, 0};
 
 // Screen dimensions - defaults that will be updated by detection
 int screen_width = 1920;  // Default fallback width
 int screen_height = 1080; // Default fallback height
 
+// Virtual touch surface, touch_surface_factor times the (scaled) screen.
+// A larger surface means the fingers reach an edge far less often.
+static int surface_width = 1920;
+static int surface_height = 1080;
+
+// libinput assumes a 69x50 mm touchpad when a device declares no
+// resolution, which is what the old screen-sized surface relied on. Keep
+// the same units-per-mm so scroll speed is unchanged by the larger surface.
+#define TOUCHPAD_DEFAULT_WIDTH_MM 69
+#define TOUCHPAD_DEFAULT_HEIGHT_MM 50
+
+// Largest surface side; the quarter of INT_MAX left over keeps finger
+// positions plus a frame's motion inside the s32 ABS range
+#define MAX_TOUCH_SURFACE_UNITS (INT_MAX / 4)
+
 // Global state for finger positions (initial positions)
 static int finger0_x;  // left of center
 static int finger0_y;
 static int finger1_x;  // right of center
 static int finger1_y;
 
+// --- Multitouch frame encoder ---
+// Events for a frame are assembled in a preallocated array and written with
+// a single write() when the frame is committed. The encoder remembers what it
+// last emitted (selected slot, per-slot tracking ID and position, touch
+// buttons) and skips anything that has not changed, so a movement frame is
+// just the axis values that actually moved.
+#define MT_SLOT_COUNT 4 // Two finger pairs, see rotate_finger_pair()
+#define MT_FRAME_MAX 32
+#define MT_VALUE_UNKNOWN (-2147483647 - 1)
+
+typedef struct {
+    int tracking_id;
+    int x;
+    int y;
+} MtSlotState;
+
+typedef struct {
+    struct input_event events[MT_FRAME_MAX];
+    int count;
+    int frame_start;                  // First event after the last mt_frame_sync()
+    int slot;                         // Last ABS_MT_SLOT emitted
+    MtSlotState slots[MT_SLOT_COUNT];
+    int btn_touch;
+    int btn_doubletap;
+} MtFrameEncoder;
+
+static MtFrameEncoder mt_frame;
+static UinputOutbox mt_outbox; // Frames the device could not take yet
+
+// Forget everything we believe the kernel knows, forcing a full resend
+static void mt_frame_invalidate(void) {
+    mt_frame.count = 0;
+    mt_frame.frame_start = 0;
+    mt_frame.slot = MT_VALUE_UNKNOWN;
+    for (int i = 0; i < MT_SLOT_COUNT; i++) {
+        mt_frame.slots[i].tracking_id = MT_VALUE_UNKNOWN;
+        mt_frame.slots[i].x = MT_VALUE_UNKNOWN;
+        mt_frame.slots[i].y = MT_VALUE_UNKNOWN;
+    }
+    mt_frame.btn_touch = MT_VALUE_UNKNOWN;
+    mt_frame.btn_doubletap = MT_VALUE_UNKNOWN;
+}
+
+static void mt_frame_push(int type, int code, int value) {
+    if (mt_frame.count >= MT_FRAME_MAX - 1) { // Always leave room for SYN_REPORT
+        return;
+    }
+    struct input_event *ev = &mt_frame.events[mt_frame.count++];
+    ev->type = type;
+    ev->code = code;
+    ev->value = value;
+}
+
+// Set a per-slot value, selecting the slot first only if it changed
+static void mt_frame_slot_value(int slot, int code, int value) {
+    int *last;
+    switch (code) {
+        case ABS_MT_TRACKING_ID: last = &mt_frame.slots[slot].tracking_id; break;
+        case ABS_MT_POSITION_X:  last = &mt_frame.slots[slot].x; break;
+        case ABS_MT_POSITION_Y:  last = &mt_frame.slots[slot].y; break;
+        default: return;
+    }
+    if (*last == value) {
+        return;
+    }
+    if (mt_frame.slot != slot) {
+        mt_frame_push(EV_ABS, ABS_MT_SLOT, slot);
+        mt_frame.slot = slot;
+    }
+    mt_frame_push(EV_ABS, code, value);
+    *last = value;
+}
+
+static void mt_frame_key(int code, int value) {
+    int *last = (code == BTN_TOUCH) ? &mt_frame.btn_touch : &mt_frame.btn_doubletap;
+    if (*last == value) {
+        return;
+    }
+    mt_frame_push(EV_KEY, code, value);
+    *last = value;
+}
+
+// Close the current frame with SYN_REPORT but keep it buffered, so the next
+// frame goes out in the same write() as this one
+static void mt_frame_sync(void) {
+    if (mt_frame.count == mt_frame.frame_start) {
+        return;
+    }
+    mt_frame_push(EV_SYN, SYN_REPORT, 0);
+    mt_frame.frame_start = mt_frame.count;
+}
+
+// Frames that put contacts down, lift them or press touch buttons must
+// always arrive; pure movement may be merged while the device is backed up
+static OutboxFrameClass mt_frame_class(void) {
+    for (int i = 0; i < mt_frame.count; i++) {
+        const struct input_event *ev = &mt_frame.events[i];
+        if (ev->type == EV_KEY || (ev->type == EV_ABS && ev->code == ABS_MT_TRACKING_ID)) {
+            return OUTBOX_ESSENTIAL;
+        }
+    }
+    return OUTBOX_COALESCE;
+}
+
+// Terminate the frame with SYN_REPORT and write it, together with any frames
+// closed by mt_frame_sync(), in one syscall. Empty frames are not written.
+// If the device is backed up the frames wait in the outbox and are retried.
+static int mt_frame_commit(const char *error_msg) {
+    if (mt_frame.count == 0) {
+        return 0;
+    }
+    mt_frame_sync();
+
+    unsigned long dropped_before = mt_outbox.dropped;
+    int rc = outbox_send(&mt_outbox, mt_frame.events, mt_frame.count, mt_frame_class());
+    mt_frame.count = 0;
+    mt_frame.frame_start = 0;
+    if (rc < 0 || mt_outbox.dropped != dropped_before) {
+        if (debug_mode) {
+            fprintf(stderr, "%s: frame dropped\n", error_msg);
+        }
+        // The kernel may not see some of what we cached; resend full state next time
+        mt_frame_invalidate();
+    }
+    return rc;
+}
+
+// The virtual fingers live in one of two slot pairs (0/1 or 2/3). At a
+// screen edge a fresh pair lands on the other pair's slots so the contact
+// never goes away mid-fling.
+static int active_pair = 0;
+static int next_tracking_id = 100;
+
+static int pair_slot(int pair, int finger) {
+    return pair * 2 + finger;
+}
+
+// Queue the touch-down of the active pair at the current finger positions
+static void mt_frame_place_pair(void) {
+    int slot0 = pair_slot(active_pair, 0);
+    int slot1 = pair_slot(active_pair, 1);
+    mt_frame_slot_value(slot0, ABS_MT_TRACKING_ID, next_tracking_id++);
+    mt_frame_slot_value(slot0, ABS_MT_POSITION_X, finger0_x);
+    mt_frame_slot_value(slot0, ABS_MT_POSITION_Y, finger0_y);
+    mt_frame_slot_value(slot1, ABS_MT_TRACKING_ID, next_tracking_id++);
+    mt_frame_slot_value(slot1, ABS_MT_POSITION_X, finger1_x);
+    mt_frame_slot_value(slot1, ABS_MT_POSITION_Y, finger1_y);
+    if (next_tracking_id > 60000) {
+        next_tracking_id = 100;
+    }
+}
+
+// Queue the lift of both fingers of a pair
+static void mt_frame_lift_pair(int pair) {
+    mt_frame_slot_value(pair_slot(pair, 0), ABS_MT_TRACKING_ID, -1);  // -1 means finger up
+    mt_frame_slot_value(pair_slot(pair, 1), ABS_MT_TRACKING_ID, -1);
+}
+
 // Detect the screen size using basic X11
 static void detect_screen_size(void) {
     Display *display = XOpenDisplay(NULL);
@@ -46,8 +217,8 @@ static void detect_screen_size(void) {
     int screen = DefaultScreen(display);
     
     // Get the screen dimensions using basic Xlib functions and apply resolution multiplier
-    screen_width = DisplayWidth(display, screen) * resolution_multiplier;
-    screen_height = DisplayHeight(display, screen) * resolution_multiplier;
+    screen_width = (int)fmin(DisplayWidth(display, screen) * resolution_multiplier, MAX_TOUCH_SURFACE_UNITS);
+    screen_height = (int)fmin(DisplayHeight(display, screen) * resolution_multiplier, MAX_TOUCH_SURFACE_UNITS);
     
     XCloseDisplay(display);
     
@@ -57,95 +228,137 @@ static void detect_screen_size(void) {
     }
 }
 
-// Move finger positions to the opposite edge after hitting a boundary.
-void jump_finger_positions(int delta) {
+// Declare one absolute axis with its range and resolution (units per mm)
+static int setup_abs_axis(int code, int maximum, int resolution, const char *name) {
+    struct uinput_abs_setup abs_setup;
+    memset(&abs_setup, 0, sizeof(abs_setup));
+    abs_setup.code = code;
+    abs_setup.absinfo.minimum = 0;
+    abs_setup.absinfo.maximum = maximum;
+    abs_setup.absinfo.resolution = resolution;
+    if (ioctl(uinput_mt_fd, UI_SET_ABSBIT, code) < 0 || ioctl(uinput_mt_fd, UI_ABS_SETUP, &abs_setup) < 0) {
+        fprintf(stderr, "Error setting up %s: %s\n", name, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+// Move finger positions to the opposite edge of the scroll axis after
+// hitting a boundary.
+void jump_finger_positions(ScrollAxis axis, int delta) {
     const int JUMP_OFFSET = 50; // Pixels offset from the edge after jumping
 
-    if (scroll_axis == SCROLL_AXIS_VERTICAL) {
+    if (axis == SCROLL_AXIS_VERTICAL) {
         if (delta < 0) { // Hit top edge (0), jump to bottom
-            finger0_y = screen_height - JUMP_OFFSET;
-            finger1_y = screen_height - JUMP_OFFSET;
+            finger0_y = surface_height - JUMP_OFFSET;
+            finger1_y = surface_height - JUMP_OFFSET;
             if (debug_mode) printf("BOUNDARY JUMP: Hit Top -> Jumped to Y=%d\n", finger0_y);
-        } else { // Hit bottom edge (screen_height), jump to top
+        } else { // Hit bottom edge (surface_height), jump to top
             finger0_y = JUMP_OFFSET;
             finger1_y = JUMP_OFFSET;
             if (debug_mode) printf("BOUNDARY JUMP: Hit Bottom -> Jumped to Y=%d\n", finger0_y);
         }
         // Keep X positions centered
-        finger0_x = screen_width / 2 - 50;
-        finger1_x = screen_width / 2 + 50;
+        finger0_x = surface_width / 2 - 50;
+        finger1_x = surface_width / 2 + 50;
     } else { // SCROLL_AXIS_HORIZONTAL
         if (delta < 0) { // Hit left edge (0), jump to right
-            finger0_x = screen_width - JUMP_OFFSET - 100; // Adjust for finger spacing
-            finger1_x = screen_width - JUMP_OFFSET;
+            finger0_x = surface_width - JUMP_OFFSET - 100; // Adjust for finger spacing
+            finger1_x = surface_width - JUMP_OFFSET;
              if (debug_mode) printf("BOUNDARY JUMP: Hit Left -> Jumped to X=%d\n", finger1_x);
-        } else { // Hit right edge (screen_width), jump to left
+        } else { // Hit right edge (surface_width), jump to left
             finger0_x = JUMP_OFFSET;
             finger1_x = JUMP_OFFSET + 100; // Adjust for finger spacing
             if (debug_mode) printf("BOUNDARY JUMP: Hit Right -> Jumped to X=%d\n", finger0_x);
         }
         // Keep Y positions centered
-        finger0_y = screen_height / 2;
-        finger1_y = screen_height / 2;
+        finger0_y = surface_height / 2;
+        finger1_y = surface_height / 2;
     }
 }
 
 // Set up a virtual multitouch device.
-// Reset finger positions based on screen size (Made non-static)
+// Reset finger positions to the middle of the touch surface (Made non-static)
 void reset_finger_positions(void) {
-    finger0_x = screen_width / 2 - 50;  // left of center
-    finger0_y = screen_height / 2;
-    finger1_x = screen_width / 2 + 50;  // right of center
-    finger1_y = screen_height / 2;
+    finger0_x = surface_width / 2 - 50;  // left of center
+    finger0_y = surface_height / 2;
+    finger1_x = surface_width / 2 + 50;  // right of center
+    finger1_y = surface_height / 2;
+}
+
+// One side of the touch surface. A large resolution_multiplier times
+// touch_surface_factor would overflow the int ABS range, so the side is
+// capped with headroom for the finger arithmetic.
+static int touch_surface_extent(int screen_extent) {
+    double extent = (double)screen_extent * touch_surface_factor;
+    if (extent > MAX_TOUCH_SURFACE_UNITS) {
+        fprintf(stderr, "Warning: touch surface of %.0f units is too large, capping it to %d\n",
+                extent, MAX_TOUCH_SURFACE_UNITS);
+        return MAX_TOUCH_SURFACE_UNITS;
+    }
+    return extent >= 1.0 ? (int)extent : 1;
+}
+
+// Size the touch surface from the screen and point the frame encoder at
+// fd. The pipeline test attaches a pipe and decodes the frames.
+void attach_multitouch_encoder(int fd) {
+    surface_width = touch_surface_extent(screen_width);
+    surface_height = touch_surface_extent(screen_height);
+    // Initialize finger positions based on surface size
+    reset_finger_positions();
+    uinput_mt_fd = fd;
+    outbox_init(&mt_outbox, "Multitouch device", fd);
+    mt_frame_invalidate();
 }
 
 int setup_virtual_multitouch_device(void) {
     // Detect screen size first
     detect_screen_size();
-    // Initialize finger positions based on screen size
-    reset_finger_positions();
-    
-    uinput_mt_fd = open("/dev/uinput", O_WRONLY | O_NONBLOCK);
-    if (uinput_mt_fd < 0) {
+
+    int fd = open("/dev/uinput", O_WRONLY | O_NONBLOCK);
+    if (fd < 0) {
         perror("Error opening /dev/uinput for multitouch");
         return -1;
     }
+    attach_multitouch_encoder(fd);
     
     // Enable event types
     if (ioctl(uinput_mt_fd, UI_SET_EVBIT, EV_ABS) < 0) { perror("Error setting EV_ABS"); return -1; }
     if (ioctl(uinput_mt_fd, UI_SET_EVBIT, EV_KEY) < 0) { perror("Error setting EV_KEY"); return -1; }
     if (ioctl(uinput_mt_fd, UI_SET_EVBIT, EV_SYN) < 0) { perror("Error setting EV_SYN"); return -1; }
     
-    // Enable multitouch capabilities
-    if (ioctl(uinput_mt_fd, UI_SET_ABSBIT, ABS_MT_SLOT) < 0) { perror("Error setting ABS_MT_SLOT"); return -1; }
-    if (ioctl(uinput_mt_fd, UI_SET_ABSBIT, ABS_MT_TRACKING_ID) < 0) { perror("Error setting ABS_MT_TRACKING_ID"); return -1; }
-    if (ioctl(uinput_mt_fd, UI_SET_ABSBIT, ABS_MT_POSITION_X) < 0) { perror("Error setting ABS_MT_POSITION_X"); return -1; }
-    if (ioctl(uinput_mt_fd, UI_SET_ABSBIT, ABS_MT_POSITION_Y) < 0) { perror("Error setting ABS_MT_POSITION_Y"); return -1; }
-    
-    // Enable touch buttons
+    // Enable touch buttons. BTN_LEFT is never pressed but is expected of a buttonpad.
+    if (ioctl(uinput_mt_fd, UI_SET_KEYBIT, BTN_LEFT) < 0) { perror("Error setting BTN_LEFT"); return -1; }
     if (ioctl(uinput_mt_fd, UI_SET_KEYBIT, BTN_TOUCH) < 0) { perror("Error setting BTN_TOUCH"); return -1; }
     if (ioctl(uinput_mt_fd, UI_SET_KEYBIT, BTN_TOOL_FINGER) < 0) { perror("Error setting BTN_TOOL_FINGER"); return -1; }
     if (ioctl(uinput_mt_fd, UI_SET_KEYBIT, BTN_TOOL_DOUBLETAP) < 0) { perror("Error setting BTN_TOOL_DOUBLETAP"); return -1; }
-    
+
+    // Present as an indirect pointer (a touchpad, not a touchscreen) clickpad
+    if (ioctl(uinput_mt_fd, UI_SET_PROPBIT, INPUT_PROP_POINTER) < 0) { perror("Error setting INPUT_PROP_POINTER"); return -1; }
+    if (ioctl(uinput_mt_fd, UI_SET_PROPBIT, INPUT_PROP_BUTTONPAD) < 0) { perror("Error setting INPUT_PROP_BUTTONPAD"); return -1; }
+
+    // Multitouch axes with explicit resolution so the compositor can derive
+    // physical units instead of guessing them from the axis range
+    int x_resolution = screen_width / TOUCHPAD_DEFAULT_WIDTH_MM;
+    int y_resolution = screen_height / TOUCHPAD_DEFAULT_HEIGHT_MM;
+    if (x_resolution < 1) x_resolution = 1;
+    if (y_resolution < 1) y_resolution = 1;
+    if (setup_abs_axis(ABS_MT_SLOT, MT_SLOT_COUNT - 1, 0, "ABS_MT_SLOT") < 0) return -1;
+    if (setup_abs_axis(ABS_MT_TRACKING_ID, 65535, 0, "ABS_MT_TRACKING_ID") < 0) return -1;
+    if (setup_abs_axis(ABS_MT_POSITION_X, surface_width, x_resolution, "ABS_MT_POSITION_X") < 0) return -1;
+    if (setup_abs_axis(ABS_MT_POSITION_Y, surface_height, y_resolution, "ABS_MT_POSITION_Y") < 0) return -1;
+
     // Configure the virtual device
-    struct uinput_user_dev uidev;
-    memset(&uidev, 0, sizeof(uidev));
-    snprintf(uidev.name, UINPUT_MAX_NAME_SIZE, "momentum mouse Touchpad");
-    uidev.id.bustype = BUS_USB;
-    uidev.id.vendor  = 0x1234;
-    uidev.id.product = 0x5678;
-    uidev.id.version = 1;
-    
-    // Set absolute axis ranges - use detected screen size
-    uidev.absmin[ABS_MT_POSITION_X] = 0;
-    uidev.absmax[ABS_MT_POSITION_X] = screen_width;
-    uidev.absmin[ABS_MT_POSITION_Y] = 0;
-    uidev.absmax[ABS_MT_POSITION_Y] = screen_height;
-    uidev.absmin[ABS_MT_SLOT] = 0;
-    uidev.absmax[ABS_MT_SLOT] = 1;
-    
-    if (write(uinput_mt_fd, &uidev, sizeof(uidev)) < 0) {
-        perror("Error writing multitouch uinput device");
+    struct uinput_setup usetup;
+    memset(&usetup, 0, sizeof(usetup));
+    snprintf(usetup.name, UINPUT_MAX_NAME_SIZE, "momentum mouse Touchpad");
+    usetup.id.bustype = BUS_USB;
+    usetup.id.vendor  = 0x1234;
+    usetup.id.product = 0x5678;
+    usetup.id.version = 1;
+
+    if (ioctl(uinput_mt_fd, UI_DEV_SETUP, &usetup) < 0) {
+        perror("Error setting up multitouch uinput device");
         return -1;
     }
     if (ioctl(uinput_mt_fd, UI_DEV_CREATE) < 0) {
@@ -154,7 +367,8 @@ int setup_virtual_multitouch_device(void) {
     }
     
     if (debug_mode) {
-        printf("Virtual multitouch device created successfully\n");
+        printf("Virtual multitouch device created successfully (surface %dx%d, resolution %dx%d units/mm)\n",
+               surface_width, surface_height, x_resolution, y_resolution);
     }
     return 0;
 }
@@ -168,38 +382,87 @@ static double time_diff_in_seconds(struct timeval *start, struct timeval *end) {
     return seconds + microseconds;
 }
 
-// Helper function to write an event and check for errors
-static int write_event_mt(struct input_event *ev, const char *error_msg, int *ending_flag) {
-    if (write(uinput_mt_fd, ev, sizeof(*ev)) < 0) {
-        if (debug_mode) {
-            perror(error_msg);
-        }
-        if (ending_flag) {
-            *ending_flag = 0;
-        }
-        return -1;
+
+
+// Seamless boundary crossing: a new pair lands at the opposite edge on the
+// spare slots and the old pair lifts, all in the same frame. BTN_TOUCH and
+// BTN_TOOL_DOUBLETAP stay pressed, so the compositor sees two contacts
+// throughout and there is no gesture end, no gesture gap and no input
+// blackout while the fingers are repositioned.
+static int rotate_finger_pair(ScrollAxis axis, int delta) {
+    int old_pair = active_pair;
+
+    jump_finger_positions(axis, delta);
+    active_pair = 1 - old_pair;
+    // New contacts first, so the old pair is released last within the frame
+    mt_frame_place_pair();
+    mt_frame_lift_pair(old_pair);
+    if (mt_frame_commit("Error: finger pair rotation frame") < 0) return -1;
+
+    if (debug_mode) {
+        printf("BOUNDARY: Rotated fingers to slots %d/%d\n",
+               pair_slot(active_pair, 0), pair_slot(active_pair, 1));
     }
     return 0;
 }
 
-// Flag to track post-boundary transition frames
-int post_boundary_frames = 0; // Note: This might need mutex protection if accessed by multiple threads, but currently only inertia thread uses it.
+// Milliseconds until a new gesture may start, 0 if it may start now
+long multitouch_gesture_gap_remaining_ms(void) {
+    if (touch_active || last_gesture_end_time.tv_sec == 0) {
+        return 0;
+    }
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    long elapsed_ms = (now.tv_sec - last_gesture_end_time.tv_sec) * 1000 +
+                      (now.tv_usec - last_gesture_end_time.tv_usec) / 1000;
+    return elapsed_ms < MIN_GESTURE_INTERVAL_MS ? MIN_GESTURE_INTERVAL_MS - elapsed_ms : 0;
+}
 
+// Queue the touch-down frame (both fingers plus touch buttons) without
+// writing it; the next commit sends it in the same write() as the motion
+static void stage_touch_down(void) {
+    mt_frame_place_pair();
+    mt_frame_key(BTN_TOUCH, 1);
+    mt_frame_key(BTN_TOOL_DOUBLETAP, 1);
+    mt_frame_sync();
+    touch_active = 1;
+}
 
 // This function updates finger positions by adding the delta
 // and sends out updated multitouch events.
 // It should ONLY be called by the inertia thread.
 // It does NOT access shared state like velocity/position directly.
 int emit_two_finger_scroll_event(int delta) {
-    struct input_event ev;
-    // static int boundary_reset = 0; // Removed - Use global boundary_reset_in_progress
+    ScrollAxis axis = config_read_lock()->scroll_axis;
+    config_read_unlock();
+
+    // Starting a new gesture too soon after the last one ended can be
+    // interpreted as a right-click. Instead of sleeping on the inertia thread,
+    // defer the touch-down to a later frame and keep the motion until then.
+    if (!touch_active) {
+        long wait_ms = multitouch_gesture_gap_remaining_ms();
+        if (wait_ms > 0) {
+            deferred_delta += delta;
+            if (debug_mode > 1) {
+                printf("EMIT_MT: Deferring touch-down for %ld ms (held delta %d)\n", wait_ms, deferred_delta);
+            }
+            return 0;
+        }
+
+        // Put both fingers down in their own frame; it is written together
+        // with this movement frame below
+        stage_touch_down();
+    }
+    // Replay motion held back for the touch-down or by a pair rotation
+    delta += deferred_delta;
+    deferred_delta = 0;
 
     // Calculate new positions based on scroll axis
     int new_finger0_pos, new_finger1_pos;
     int *finger0_pos, *finger1_pos;
     int screen_limit; // Store screen limit for boundary check
 
-    if (scroll_axis == SCROLL_AXIS_VERTICAL) {
+    if (axis == SCROLL_AXIS_VERTICAL) {
         // Vertical scrolling - update Y positions
         finger0_pos = &finger0_y;
         finger1_pos = &finger1_y;
@@ -216,60 +479,51 @@ int emit_two_finger_scroll_event(int delta) {
     // Log detailed position information before boundary check (Removed velocity/position)
     if (debug_mode > 1) { // Reduce verbosity
         printf("EMIT_MT: finger0_%s=%d, delta=%d, new_finger0_%s=%d\n",
-               (scroll_axis == SCROLL_AXIS_VERTICAL) ? "y" : "x",
+               (axis == SCROLL_AXIS_VERTICAL) ? "y" : "x",
                *finger0_pos, delta,
-               (scroll_axis == SCROLL_AXIS_VERTICAL) ? "y" : "x",
+               (axis == SCROLL_AXIS_VERTICAL) ? "y" : "x",
                new_finger0_pos);
     }
 
     // --- Boundary Check ---
-    screen_limit = (scroll_axis == SCROLL_AXIS_VERTICAL) ? screen_height : screen_width;
+    screen_limit = (axis == SCROLL_AXIS_VERTICAL) ? surface_height : surface_width;
     // Check if *either* finger would go out of bounds based on the calculated delta
-    if (!boundary_reset_in_progress && (new_finger0_pos < 0 || new_finger0_pos > screen_limit || new_finger1_pos < 0 || new_finger1_pos > screen_limit)) {
+    if (new_finger0_pos < 0 || new_finger0_pos > screen_limit || new_finger1_pos < 0 || new_finger1_pos > screen_limit) {
         if (debug_mode) {
             printf("BOUNDARY: Hit detected in emitter! finger0_pos=%d, finger1_pos=%d, delta=%d, limit=%d\n",
                    *finger0_pos, *finger1_pos, delta, screen_limit);
         }
-        // boundary_reset = 1; // Removed
-        boundary_reset_in_progress = 1; // Set global flag
-        gettimeofday(&last_boundary_reset_time, NULL);
-
-        end_multitouch_gesture();   // End the current touch sequence visually
-        jump_finger_positions(delta); // Jump fingers to the opposite edge
-
-        // DO NOT stop inertia here. Let velocity persist.
-        // The visual gesture ends, positions reset, and cooldown prevents immediate re-trigger.
-
-        return 0; // Indicate event was handled by reset, don't proceed further
+        // Hand the fling over to a new finger pair at the opposite edge.
+        // This frame's motion is carried into the next movement frame.
+        deferred_delta += delta;
+        return rotate_finger_pair(axis, delta);
     }
     // --- End Boundary Check ---
 
 
-    // Update positions if delta is non-zero and not immediately after a boundary reset
-    if (delta != 0) { // Removed !boundary_reset check, cooldown handles this
+    // Update positions if delta is non-zero
+    if (delta != 0) {
         *finger0_pos = new_finger0_pos;
         *finger1_pos = new_finger1_pos;
 
         // For horizontal scrolling, ensure finger1 is at the right offset from finger0
-        if (scroll_axis == SCROLL_AXIS_HORIZONTAL) {
+        if (axis == SCROLL_AXIS_HORIZONTAL) {
             finger1_x = finger0_x + 100; // Maintain relative horizontal position
         }
     }
-    // boundary_reset = 0; // Removed
-
-    // Clamping logic removed - boundary reset handles extremes by stopping/resetting
+    // No clamping needed - rotate_finger_pair handles the edges
 
     // Log final position after all adjustments
     if (debug_mode > 1) { // Reduce verbosity
         printf("EMIT_MT: Final finger0_%s=%d, finger1_%s=%d\n",
-               (scroll_axis == SCROLL_AXIS_VERTICAL) ? "y" : "x",
+               (axis == SCROLL_AXIS_VERTICAL) ? "y" : "x",
                *finger0_pos,
-               (scroll_axis == SCROLL_AXIS_VERTICAL) ? "y" : "x",
+               (axis == SCROLL_AXIS_VERTICAL) ? "y" : "x",
                *finger1_pos);
     }
 
     if (debug_mode > 1) { // Reduce verbosity
-        if (scroll_axis == SCROLL_AXIS_VERTICAL) {
+        if (axis == SCROLL_AXIS_VERTICAL) {
             printf("EMIT_MT: Emitting vertical event delta: %d (Y: %d, %d)\n",
                    delta, finger0_y, finger1_y);
         } else {
@@ -279,264 +533,146 @@ int emit_two_finger_scroll_event(int delta) {
     }
     
     
-    // If touch isn't active yet, check if we need to enforce a delay
-    if (!touch_active) {
-        // Check if enough time has passed since the last gesture ended
-        struct timeval now;
-        gettimeofday(&now, NULL);
-        
-        // Calculate milliseconds since last gesture ended
-        long elapsed_ms = 0;
-        if (last_gesture_end_time.tv_sec > 0) {
-            elapsed_ms = (now.tv_sec - last_gesture_end_time.tv_sec) * 1000 + 
-                         (now.tv_usec - last_gesture_end_time.tv_usec) / 1000;
-        }
-        
-        // If we're starting a new gesture too soon after the last one ended,
-        // add a delay to prevent right-click interpretation
-        if (elapsed_ms < MIN_GESTURE_INTERVAL_MS) {
-            int delay_needed = MIN_GESTURE_INTERVAL_MS - elapsed_ms;
-            if (debug_mode) {
-                printf("Adding %d ms delay between gestures to prevent right-click\n", delay_needed);
-            }
-            usleep(delay_needed * 1000);
-        }
-        
-        // First, select slot 0
-        memset(&ev, 0, sizeof(ev));
-        ev.type = EV_ABS;
-        ev.code = ABS_MT_SLOT;
-        ev.value = 0;
-        if (write_event_mt(&ev, "Error: slot 0", NULL) < 0) return -1;
-        
-        // Set tracking ID for first finger
-        memset(&ev, 0, sizeof(ev));
-        ev.type = EV_ABS;
-        ev.code = ABS_MT_TRACKING_ID;
-        ev.value = 100;
-        if (write_event_mt(&ev, "Error: tracking ID for finger 0", NULL) < 0) return -1;
-        
-        // Set initial X position for first finger
-        memset(&ev, 0, sizeof(ev));
-        ev.type = EV_ABS;
-        ev.code = ABS_MT_POSITION_X;
-        ev.value = finger0_x;
-        if (write_event_mt(&ev, "Error: position X for finger 0", NULL) < 0) return -1;
-        
-        // Set initial Y position for first finger
-        memset(&ev, 0, sizeof(ev));
-        ev.type = EV_ABS;
-        ev.code = ABS_MT_POSITION_Y;
-        ev.value = finger0_y;
-        if (write_event_mt(&ev, "Error: position Y for finger 0", NULL) < 0) return -1;
-        
-        // Now select slot 1
-        memset(&ev, 0, sizeof(ev));
-        ev.type = EV_ABS;
-        ev.code = ABS_MT_SLOT;
-        ev.value = 1;
-        if (write_event_mt(&ev, "Error: slot 1", NULL) < 0) return -1;
-        
-        // Set tracking ID for second finger
-        memset(&ev, 0, sizeof(ev));
-        ev.type = EV_ABS;
-        ev.code = ABS_MT_TRACKING_ID;
-        ev.value = 200;
-        if (write_event_mt(&ev, "Error: tracking ID for finger 1", NULL) < 0) return -1;
-        
-        // Set initial X position for second finger
-        memset(&ev, 0, sizeof(ev));
-        ev.type = EV_ABS;
-        ev.code = ABS_MT_POSITION_X;
-        ev.value = finger1_x;
-        if (write_event_mt(&ev, "Error: position X for finger 1", NULL) < 0) return -1;
-        
-        // Set initial Y position for second finger
-        memset(&ev, 0, sizeof(ev));
-        ev.type = EV_ABS;
-        ev.code = ABS_MT_POSITION_Y;
-        ev.value = finger1_y;
-        if (write_event_mt(&ev, "Error: position Y for finger 1", NULL) < 0) return -1;
-        
-        // Now set BTN_TOUCH to indicate contact
-        memset(&ev, 0, sizeof(ev));
-        ev.type = EV_KEY;
-        ev.code = BTN_TOUCH;
-        ev.value = 1;
-        if (write_event_mt(&ev, "Error: BTN_TOUCH press", NULL) < 0) return -1;
-        
-        // Set BTN_TOOL_DOUBLETAP to indicate two fingers
-        memset(&ev, 0, sizeof(ev));
-        ev.type = EV_KEY;
-        ev.code = BTN_TOOL_DOUBLETAP;
-        ev.value = 1;
-        if (write_event_mt(&ev, "Error: BTN_TOOL_DOUBLETAP press", NULL) < 0) return -1;
-        
-        // Sync to apply the initial touch
-        memset(&ev, 0, sizeof(ev));
-        ev.type = EV_SYN;
-        ev.code = SYN_REPORT;
-        ev.value = 0;
-        if (write_event_mt(&ev, "Error: SYN_REPORT", NULL) < 0) return -1;
-        
-        touch_active = 1;
-        
-        // No delay needed - removed for faster response
-    }
-    
-    // Now update the positions for the movement
-    
-    // Update finger positions based on scroll axis
-    if (scroll_axis == SCROLL_AXIS_VERTICAL) {
-        // Update finger 0 Y position
-        memset(&ev, 0, sizeof(ev));
-        ev.type = EV_ABS;
-        ev.code = ABS_MT_SLOT;
-        ev.value = 0;
-        if (write_event_mt(&ev, "Error: slot 0", NULL) < 0) return -1;
-        
-        memset(&ev, 0, sizeof(ev));
-        ev.type = EV_ABS;
-        ev.code = ABS_MT_POSITION_Y;
-        ev.value = finger0_y;
-        if (write_event_mt(&ev, "Error: position Y for finger 0", NULL) < 0) return -1;
-        
-        // Update finger 1 Y position
-        memset(&ev, 0, sizeof(ev));
-        ev.type = EV_ABS;
-        ev.code = ABS_MT_SLOT;
-        ev.value = 1;
-        if (write_event_mt(&ev, "Error: slot 1", NULL) < 0) return -1;
-        
-        memset(&ev, 0, sizeof(ev));
-        ev.type = EV_ABS;
-        ev.code = ABS_MT_POSITION_Y;
-        ev.value = finger1_y;
-        if (write_event_mt(&ev, "Error: position Y for finger 1", NULL) < 0) return -1;
-    } else {
-        // Update finger 0 X position
-        memset(&ev, 0, sizeof(ev));
-        ev.type = EV_ABS;
-        ev.code = ABS_MT_SLOT;
-        ev.value = 0;
-        if (write_event_mt(&ev, "Error: slot 0", NULL) < 0) return -1;
-        
-        memset(&ev, 0, sizeof(ev));
-        ev.type = EV_ABS;
-        ev.code = ABS_MT_POSITION_X;
-        ev.value = finger0_x;
-        if (write_event_mt(&ev, "Error: position X for finger 0", NULL) < 0) return -1;
-        
-        // Update finger 1 X position
-        memset(&ev, 0, sizeof(ev));
-        ev.type = EV_ABS;
-        ev.code = ABS_MT_SLOT;
-        ev.value = 1;
-        if (write_event_mt(&ev, "Error: slot 1", NULL) < 0) return -1;
-        
-        memset(&ev, 0, sizeof(ev));
-        ev.type = EV_ABS;
-        ev.code = ABS_MT_POSITION_X;
-        ev.value = finger1_x;
-        if (write_event_mt(&ev, "Error: position X for finger 1", NULL) < 0) return -1;
-    }
-    
-    // Final sync event
-    // Removed post-reset debug logging block
-
-    memset(&ev, 0, sizeof(ev));
-    ev.type = EV_SYN;
-    ev.code = SYN_REPORT;
-    ev.value = 0;
-    if (write_event_mt(&ev, "Error: SYN_REPORT", NULL) < 0) return -1;
-    
+    // Movement frame: the encoder drops the axis that did not move, so this
+    // is normally slot/position pairs for the scroll axis only
+    int slot0 = pair_slot(active_pair, 0);
+    int slot1 = pair_slot(active_pair, 1);
+    mt_frame_slot_value(slot0, ABS_MT_POSITION_X, finger0_x);
+    mt_frame_slot_value(slot0, ABS_MT_POSITION_Y, finger0_y);
+    mt_frame_slot_value(slot1, ABS_MT_POSITION_X, finger1_x);
+    mt_frame_slot_value(slot1, ABS_MT_POSITION_Y, finger1_y);
+    if (mt_frame_commit("Error: movement frame") < 0) return -1;
+
     return 0;
 }
 
 
 void end_multitouch_gesture(void) {
-    static int ending_in_progress = 0;
-    
-    // Prevent multiple simultaneous calls
-    if (ending_in_progress) {
-        return;
-    }
-    
-    ending_in_progress = 1;
-    
+    // A gesture that never touched down has nothing to lift, but any motion
+    // held back for it belongs to the fling that just ended
+    deferred_delta = 0;
+    touch_lingering = 0;
+
     if (!touch_active || uinput_mt_fd < 0) {
-        ending_in_progress = 0;
         return;
     }
-    
+
     if (debug_mode) {
         printf("Ending multitouch gesture\n");
     }
-    
+
     // Record the time when this gesture ends
     gettimeofday(&last_gesture_end_time, NULL);
-    
-    struct input_event ev;
-    
-    
-    // Release finger 0
-    memset(&ev, 0, sizeof(ev));
-    ev.type = EV_ABS;
-    ev.code = ABS_MT_SLOT;
-    ev.value = 0;
-    if (write_event_mt(&ev, "Error: slot 0", &ending_in_progress) < 0) return;
-    
-    memset(&ev, 0, sizeof(ev));
-    ev.type = EV_ABS;
-    ev.code = ABS_MT_TRACKING_ID;
-    ev.value = -1;  // -1 means finger up
-    if (write_event_mt(&ev, "Error: tracking ID release for finger 0", &ending_in_progress) < 0) return;
-    
-    // Release finger 1
-    memset(&ev, 0, sizeof(ev));
-    ev.type = EV_ABS;
-    ev.code = ABS_MT_SLOT;
-    ev.value = 1;
-    if (write_event_mt(&ev, "Error: slot 1", &ending_in_progress) < 0) return;
-    
-    memset(&ev, 0, sizeof(ev));
-    ev.type = EV_ABS;
-    ev.code = ABS_MT_TRACKING_ID;
-    ev.value = -1;  // -1 means finger up
-    if (write_event_mt(&ev, "Error: tracking ID release for finger 1", &ending_in_progress) < 0) return;
-    
-    // Release BTN_TOUCH and BTN_TOOL_DOUBLETAP
-    memset(&ev, 0, sizeof(ev));
-    ev.type = EV_KEY;
-    ev.code = BTN_TOUCH;
-    ev.value = 0;
-    if (write_event_mt(&ev, "Error: BTN_TOUCH release", &ending_in_progress) < 0) return;
-    
-    memset(&ev, 0, sizeof(ev));
-    ev.type = EV_KEY;
-    ev.code = BTN_TOOL_DOUBLETAP;
-    ev.value = 0;
-    if (write_event_mt(&ev, "Error: BTN_TOOL_DOUBLETAP release", &ending_in_progress) < 0) return;
-    
-    // Final sync event
-    memset(&ev, 0, sizeof(ev));
-    ev.type = EV_SYN;
-    ev.code = SYN_REPORT;
-    ev.value = 0;
-    if (write_event_mt(&ev, "Error: SYN_REPORT", &ending_in_progress) < 0) return;
-    
+
+    // Lift both fingers and release the touch buttons in one frame
+    mt_frame_lift_pair(active_pair);
+    mt_frame_key(BTN_TOUCH, 0);
+    mt_frame_key(BTN_TOOL_DOUBLETAP, 0);
+    if (mt_frame_commit("Error: touch-up frame") < 0) return;
+
     touch_active = 0;
-    
+
     // Reset finger positions for next gesture
     reset_finger_positions();
-    
-    ending_in_progress = 0;
 }
 
 void destroy_virtual_multitouch_device(void) {
+    // Never leave a (lingering) contact down on a device that goes away
+    end_multitouch_gesture();
+    outbox_flush(&mt_outbox);
+    if (debug_mode) {
+        outbox_report(&mt_outbox);
+    }
     if (ioctl(uinput_mt_fd, UI_DEV_DESTROY) < 0) {
         perror("Error destroying multitouch device");
     }
     close(uinput_mt_fd);
     uinput_mt_fd = -1;
 }
+
+// --- Multitouch backend ---
+// Integrates velocity into touchpad units; the touch stays down for the
+// whole fling and is lifted by end(), or touch_linger_ms after it
+
+static ScrollIntegrator multitouch_integrator;
+
+static void multitouch_begin(void) {
+    scroll_integrator_reset(&multitouch_integrator);
+    if (touch_lingering) {
+        // Reuse the contact left down by the previous fling: no touch-down
+        // sequence and no gesture gap
+        touch_lingering = 0;
+        if (debug_mode > 1) printf("EMIT_MT: Reusing lingering contact\n");
+        return;
+    }
+    // Pre-arm: put the fingers down as soon as the fling starts. The frame is
+    // only staged here and goes out in the same write() as the first motion.
+    if (touch_prearm && !touch_active && uinput_mt_fd >= 0 &&
+        multitouch_gesture_gap_remaining_ms() == 0) {
+        stage_touch_down();
+    }
+}
+
+static int multitouch_frame(double velocity, double dt) {
+    int delta = scroll_integrator_step(&multitouch_integrator, velocity, dt, 1.0);
+    if (delta == 0) {
+        // Flush a pre-armed touch-down even if there is no motion yet
+        return mt_frame_commit("Error: touch-down frame");
+    }
+    return emit_two_finger_scroll_event(delta);
+}
+
+static void multitouch_end(void) {
+    scroll_integrator_reset(&multitouch_integrator);
+    int linger_ms = config_read_lock()->touch_linger_ms;
+    config_read_unlock();
+    if (linger_ms > 0 && touch_active) {
+        // Keep the contact so a quick follow-up fling continues this gesture
+        deferred_delta = 0;
+        touch_lingering = 1;
+        gettimeofday(&linger_until, NULL);
+        linger_until.tv_usec += (long)linger_ms * 1000;
+        linger_until.tv_sec += linger_until.tv_usec / 1000000;
+        linger_until.tv_usec %= 1000000;
+        return;
+    }
+    end_multitouch_gesture();
+}
+
+// Retry frames the device could not take, and lift a lingering contact
+// once its time is up
+static long multitouch_idle(void) {
+    if (outbox_pending(&mt_outbox) > 0 && outbox_flush(&mt_outbox) > 0) {
+        return 1;
+    }
+    if (!touch_lingering) {
+        return -1;
+    }
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    long remaining_ms = (linger_until.tv_sec - now.tv_sec) * 1000 +
+                        (linger_until.tv_usec - now.tv_usec) / 1000;
+    if (remaining_ms > 0) {
+        return remaining_ms;
+    }
+    end_multitouch_gesture();
+    return -1;
+}
+
+static double multitouch_friction_coefficient(void) {
+    return config_time_friction();
+}
+
+const EmitterBackend multitouch_backend = {
+    .name = "multitouch",
+    .setup = setup_virtual_multitouch_device,
+    .begin = multitouch_begin,
+    .frame = multitouch_frame,
+    .end = multitouch_end,
+    .idle = multitouch_idle,
+    .passthrough = emit_passthrough_event,
+    .flush = flush_passthrough_events,
+    .destroy = destroy_virtual_multitouch_device,
+    .friction_coefficient = multitouch_friction_coefficient,
+    .steps_per_position = 1.0,
+};
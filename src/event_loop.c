@@ -0,0 +1,166 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include "momentum_mouse.h"
+
+// Single-thread mode: one epoll loop on the main thread replaces the input,
+// inertia and socket threads. The source device, a frame timerfd, the focus
+// socket, a signalfd and the power supply monitor are all watched at once
+// and the inertia engine runs inline after whatever woke the loop, so a
+// wheel tick turns into a frame without waking another thread. The shared
+// mutexes are still taken, but never contended.
+
+enum {
+    LOOP_INPUT = 1,
+    LOOP_TIMER,
+    LOOP_FOCUS,
+    LOOP_SIGNAL,
+    LOOP_POWER
+};
+
+typedef enum {
+    TIMER_OFF = 0,
+    TIMER_FRAMES,  // One-shot per frame while a fling runs
+    TIMER_IDLE     // One-shot for the backend's idle() hook
+} LoopTimerMode;
+
+static int loop_watch(int epoll_fd, int fd, int tag) {
+    struct epoll_event ev = { .events = EPOLLIN, .data.u32 = tag };
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        perror("EventLoop: epoll_ctl");
+        return -1;
+    }
+    return 0;
+}
+
+static void arm_timer(int timer_fd, long interval_ns, long first_ns) {
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    spec.it_interval.tv_sec = interval_ns / 1000000000L;
+    spec.it_interval.tv_nsec = interval_ns % 1000000000L;
+    spec.it_value.tv_sec = first_ns / 1000000000L;
+    spec.it_value.tv_nsec = first_ns % 1000000000L;
+    timerfd_settime(timer_fd, 0, &spec, NULL);
+}
+
+// signal_fd delivers SIGINT/SIGTERM (see open_signal_fd in momentum_mouse.c)
+int run_event_loop(int signal_fd) {
+    int result = 0;
+    int input_fd = input_capture_fd();
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    int timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+    if (input_fd < 0 || epoll_fd < 0 || timer_fd < 0 || signal_fd < 0 ||
+        loop_watch(epoll_fd, input_fd, LOOP_INPUT) < 0 ||
+        loop_watch(epoll_fd, timer_fd, LOOP_TIMER) < 0 ||
+        loop_watch(epoll_fd, signal_fd, LOOP_SIGNAL) < 0) {
+        perror("EventLoop: setup failed");
+        result = -1;
+        running = 0;
+    }
+    // The daemon works without focus reports, as in threaded mode
+    int focus_fd = result == 0 ? open_focus_socket() : -1;
+    if (focus_fd >= 0 && loop_watch(epoll_fd, focus_fd, LOOP_FOCUS) < 0) {
+        close_focus_socket(focus_fd);
+        focus_fd = -1;
+    }
+    // Only there when power profiles follow the power source
+    int power_fd = result == 0 ? power_profile_fd() : -1;
+    if (power_fd >= 0 && loop_watch(epoll_fd, power_fd, LOOP_POWER) < 0) {
+        fprintf(stderr, "Warning: power supply changes are not watched, keeping the current profile\n");
+    }
+
+    if (result == 0) {
+        long period_us = config_read_lock()->frame_period_us;
+        config_read_unlock();
+        realtime_setup_thread("Event loop", period_us, period_us / 4);
+        inertia_engine_start();
+        printf("Event loop started.\n");
+    }
+
+    int passthrough_backlog = 0; // Frames the passthrough device has not taken yet
+    LoopTimerMode timer_mode = TIMER_OFF;
+    while (running) {
+        struct epoll_event events[8];
+        int n = epoll_wait(epoll_fd, events, 8, passthrough_backlog > 0 ? 2 : -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("EventLoop: epoll_wait");
+            result = -1;
+            break;
+        }
+
+        bool had_input = false;
+        bool timer_fired = false;
+        for (int i = 0; i < n; i++) {
+            switch (events[i].data.u32) {
+                case LOOP_INPUT:
+                    if (read_input_events() < 0) {
+                        running = 0;
+                        result = -1;
+                    }
+                    had_input = true;
+                    break;
+                case LOOP_TIMER: {
+                    uint64_t expirations;
+                    if (read(timer_fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN) {
+                        perror("EventLoop: timerfd read");
+                    }
+                    timer_fired = true;
+                    break;
+                }
+                case LOOP_FOCUS:
+                    handle_focus_message(focus_fd);
+                    break;
+                case LOOP_SIGNAL:
+                    if (read_shutdown_signal(signal_fd) != 0) {
+                        running = 0;
+                    }
+                    break;
+                case LOOP_POWER:
+                    power_profile_handle();
+                    break;
+            }
+        }
+        if (had_input || passthrough_backlog > 0) {
+            passthrough_backlog = emitter->flush();
+        }
+        if (!running) {
+            break;
+        }
+
+        long idle_wake_ms = inertia_cycle(timer_fired);
+        long period_us = config_read_lock()->frame_period_us;
+        config_read_unlock();
+        realtime_update_thread(period_us, period_us / 4);
+
+        // While a fling runs, each frame arms the next one after
+        // inertia_frame_interval_us(), which stretches as the fling slows.
+        // Input wake-ups leave a pending frame alone so they cannot keep
+        // pushing it back. Otherwise only the backend's idle() deadline,
+        // if any, wakes the loop
+        if (is_inertia_active()) {
+            if (timer_mode != TIMER_FRAMES || timer_fired) {
+                arm_timer(timer_fd, 0, inertia_frame_interval_us() * 1000L);
+                timer_mode = TIMER_FRAMES;
+            }
+        } else if (idle_wake_ms >= 0) {
+            arm_timer(timer_fd, 0, idle_wake_ms > 0 ? idle_wake_ms * 1000000L : 1000000L);
+            timer_mode = TIMER_IDLE;
+        } else if (timer_mode != TIMER_OFF) {
+            arm_timer(timer_fd, 0, 0);
+            timer_mode = TIMER_OFF;
+        }
+    }
+
+    printf("Event loop exiting.\n");
+    inertia_engine_stop();
+    if (focus_fd >= 0) close_focus_socket(focus_fd);
+    if (timer_fd >= 0) close(timer_fd);
+    if (epoll_fd >= 0) close(epoll_fd);
+    return result;
+}
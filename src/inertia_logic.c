@@ -3,24 +3,98 @@
 #include <unistd.h>
 #include <math.h>
 #include <sys/time.h>
+#include <time.h>
 #include <pthread.h> // Add this
 #include <errno.h>   // Add this for ETIMEDOUT
 #include <stdbool.h> // Ensure this is included
+#include <stdatomic.h>
 #include "momentum_mouse.h"
 
-// Forward declarations for functions used in this file
-extern void end_multitouch_gesture(void);
-extern int screen_width;
-extern int screen_height;
-extern int post_boundary_frames;  // Flag from event_emitter_mt.c
+// Physics state; every access holds state_mutex
+InertiaState inertia_state = {0};
+
+// Seqlock-published copy of the physics state for lock-free readers. Every
+// writer already holds state_mutex, so there is one writer at a time and a
+// reader never blocks it. Kept on its own cache line, away from the
+// mutex-protected state above.
+static struct {
+    _Alignas(CACHE_LINE_SIZE) atomic_uint seq; // Odd while an update is in progress
+    _Atomic double velocity;
+    _Atomic double position;
+    atomic_int active;
+    atomic_ulong frames;
+    atomic_ulong flings;
+} published_state;
+
+// Publish the current state (caller holds state_mutex)
+static void publish_inertia_state(void) {
+    unsigned seq = atomic_load_explicit(&published_state.seq, memory_order_relaxed);
+    atomic_store_explicit(&published_state.seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&published_state.velocity, inertia_state.velocity, memory_order_relaxed);
+    atomic_store_explicit(&published_state.position, inertia_state.position, memory_order_relaxed);
+    atomic_store_explicit(&published_state.active, inertia_state.active, memory_order_relaxed);
+    atomic_store_explicit(&published_state.frames, inertia_state.frames, memory_order_relaxed);
+    atomic_store_explicit(&published_state.flings, inertia_state.flings, memory_order_relaxed);
+    atomic_store_explicit(&published_state.seq, seq + 2, memory_order_release);
+}
+
+void inertia_snapshot(InertiaSnapshot *out) {
+    unsigned before, after;
+    do {
+        before = atomic_load_explicit(&published_state.seq, memory_order_acquire);
+        out->velocity = atomic_load_explicit(&published_state.velocity, memory_order_relaxed);
+        out->position = atomic_load_explicit(&published_state.position, memory_order_relaxed);
+        out->active = atomic_load_explicit(&published_state.active, memory_order_relaxed);
+        out->frames = atomic_load_explicit(&published_state.frames, memory_order_relaxed);
+        out->flings = atomic_load_explicit(&published_state.flings, memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+        after = atomic_load_explicit(&published_state.seq, memory_order_relaxed);
+    } while ((before & 1) || before != after);
+}
 
-// Use a double for finer precision.
-// Keep these global for now, but remember they need state_mutex protection
-double current_velocity = 0.0;  // Make accessible to other files
-int inertia_active = 0; // Made non-static for mutex access in is_inertia_active
-struct timeval last_time = {0}; // Made non-static for mutex access
-// Make current_position accessible to other files that need to reset it
-double current_position = 0.0; // Keep only this position variable
+// Adaptive frame pacing (see inertia_frame_interval_us). Distance advanced
+// since the last emitted frame, and the backend steps the whole fling has
+// covered so far; only the inertia engine touches these
+static double unsent_distance = 0.0;
+static double unsent_dt = 0.0;
+static double fling_steps = 0.0;
+
+// Fixed-step physics clock (see advance_physics_to). Distances are the
+// fling's travel so far, excluding the jumps wheel ticks add to position
+static double physics_time = 0.0;     // Engine clock the fixed steps have reached
+static double travel = 0.0;           // Travel at physics_time
+static double previous_travel = 0.0;  // Travel one step earlier
+static double sample_time = 0.0;      // When the emitter last sampled the fling
+static double sampled_travel = 0.0;   // Travel handed to the emitter so far
+static double frame_slot = 0.0;       // Display slot the next frame is timed for, 0 = none
+
+#define MAX_PHYSICS_CATCHUP 0.1 // Seconds of stall the physics makes up for
+
+// Physics state at the last step boundaries, so a tick that reaches the
+// engine after the physics stepped past its timestamp still lands on its
+// own step (see rewind_physics_to). Only plain physics steps are kept; any
+// other change to the fling clears the history.
+#define PHYSICS_HISTORY_STEPS 64
+
+typedef struct {
+    double time;           // physics_time of the boundary
+    double velocity;
+    double position;
+    double travel;
+    double previous_travel;
+    unsigned long frames;
+} PhysicsCheckpoint;
+
+static PhysicsCheckpoint physics_history[PHYSICS_HISTORY_STEPS];
+static unsigned physics_history_count = 0; // Valid checkpoints, the newest at physics_history_next - 1
+static unsigned physics_history_next = 0;
+
+LatencyStats first_frame_latency = {0};
+LatencyStats frame_call_time = {0};
+LatencyStats frame_phase_error = {0};
+DeadlineStats frame_deadlines = {0};
+DeadlineStats frame_slots = {0};
 
 // Threshold for detecting a significant direction change vs minor overshoot
 #define DIRECTION_CHANGE_VELOCITY_THRESHOLD 10.0
@@ -32,128 +106,125 @@ static double time_diff_in_seconds(struct timeval *start, struct timeval *end) {
     return seconds + microseconds;
 }
 
+// Engine clock: monotonic seconds used to timestamp emitted frames
+double engine_clock_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1000000000.0;
+}
+
+// Hi-res units not yet adding up to a whole tick. They belong to the
+// fling they were turned in: stop_inertia() drops them, and so does a
+// rest longer than the consecutive-scroll window.
+#define HIRES_UNITS_WINDOW 0.3 // Seconds, as for consecutive scrolls below
+static int pending_hires_units = 0;
+static struct timeval pending_hires_time = {0, 0};
+
 // Called when a new physical scroll event is captured.
 // This updates the current velocity based on incoming scroll events.
+// delta is in 1/WHEEL_HIRES_UNITS of a detent. A hi-res mouse reports one
+// detent as several events, and each of them would count as a consecutive
+// scroll below and compound the multiplier, so units are gathered into
+// whole ticks first. A legacy detent is one whole tick right away.
 void update_inertia(int delta) {
-    // Invert delta for natural scrolling
-    if (scroll_direction == SCROLL_DIRECTION_NATURAL) {
-        delta = -delta;
-    }
-    
     // Get the current time for timing calculations
     struct timeval now;
     gettimeofday(&now, NULL);
-    
-    // Check if we're in a boundary reset
-    if (boundary_reset_in_progress) {
-        // Calculate time since last boundary reset
-        double time_since_reset = time_diff_in_seconds(&last_boundary_reset_time, &now);
-        
-        // If we're in the early stages of a boundary reset (first 100ms)
-        if (time_since_reset < 0.1) {
-            if (debug_mode) {
-                printf("BOUNDARY: Ignoring scroll input during boundary reset (%.3fs after reset)\n", 
-                       time_since_reset);
-            }
-            
-            // Don't update velocity during early boundary reset
-            // Just update the last_time to prevent time gaps
-            last_time = now;
-            return;
-        }
-        
-        // For inputs slightly after the reset (100-300ms), blend them in gradually
-        if (time_since_reset < 0.3) {
-            // Scale the delta based on how far we are into the reset
-            double scale_factor = (time_since_reset - 0.1) / 0.2;  // 0.0 to 1.0
-            delta = (int)(delta * scale_factor);
-            
-            if (debug_mode) {
-                printf("BOUNDARY: Scaling scroll input during boundary reset by %.2f\n", scale_factor);
-            }
-            
-            // If delta becomes zero after scaling, just update time and return
-            if (delta == 0) {
-                last_time = now;
-                return;
-            }
-        }
+
+    // A reversal or a rest drops the fraction left over from before
+    if ((pending_hires_units > 0 && delta < 0) || (pending_hires_units < 0 && delta > 0) ||
+        time_diff_in_seconds(&pending_hires_time, &now) >= HIRES_UNITS_WINDOW) {
+        pending_hires_units = 0;
+    }
+    pending_hires_time = now;
+    pending_hires_units += delta;
+    int whole_ticks = pending_hires_units / WHEEL_HIRES_UNITS; // Toward zero
+    if (whole_ticks == 0) {
+        return;
+    }
+    pending_hires_units -= whole_ticks * WHEEL_HIRES_UNITS;
+    delta = whole_ticks * WHEEL_HIRES_UNITS;
+
+    const ConfigSnapshot *cfg = config_read_lock();
+
+    // Invert delta for natural scrolling
+    if (cfg->scroll_direction == SCROLL_DIRECTION_NATURAL) {
+        delta = -delta;
     }
     
     // Check if this is a new scroll sequence or continuing an existing one
     double dt = 0.0;
-    if (last_time.tv_sec != 0) {
-        dt = time_diff_in_seconds(&last_time, &now);
+    if (inertia_state.last_time.tv_sec != 0) {
+        dt = time_diff_in_seconds(&inertia_state.last_time, &now);
     }
-    last_time = now;
+    inertia_state.last_time = now;
     
     
     // Store the old velocity for smoothing
-    double old_velocity = current_velocity;
+    double old_velocity = inertia_state.velocity;
     
     // If this is a direction change during active inertia, handle it specially
     // Only trigger if the current velocity is significant enough
-    if (inertia_active &&
-        fabs(current_velocity) > DIRECTION_CHANGE_VELOCITY_THRESHOLD && ((current_velocity > 0 && delta < 0) || (current_velocity < 0 && delta > 0))) {
+    if (inertia_state.active &&
+        fabs(inertia_state.velocity) > DIRECTION_CHANGE_VELOCITY_THRESHOLD && ((inertia_state.velocity > 0 && delta < 0) || (inertia_state.velocity < 0 && delta > 0))) {
         if (debug_mode) {
             printf("Direction change detected during inertia: velocity=%.2f, delta=%d\n",
-                   current_velocity, delta);
+                   inertia_state.velocity, delta);
         }
          
         // Stop inertia completely. The rest of the function will handle
         // starting the new movement as if it were the beginning of a scroll sequence.
+        // The units left over from this event belong to the new movement.
+        int carried_units = pending_hires_units;
         stop_inertia();
+        pending_hires_units = carried_units;
          
         // DO NOT set velocity/position here.
-        // DO NOT set inertia_active = 1 here.
+        // DO NOT set the active flag here.
         // DO NOT return here. Let the rest of the function execute.
     }
      
     // Determine if this is a continuation of scrolling in the same direction
     // For initial scroll, use base sensitivity without multiplier
     // Increase base factor for more initial impact
-    double velocity_factor = 60.0 * (scroll_sensitivity / sensitivity_divisor); // Increased base factor
+    double velocity_factor = cfg->tick_velocity;
     
-    if (inertia_active) {
+    if (inertia_state.active) {
         // If scrolling in the same direction as current velocity and within a short time window
-        if (((current_velocity > 0 && delta > 0) || (current_velocity < 0 && delta < 0)) && dt < 0.3) {
+        if (((inertia_state.velocity > 0 && delta > 0) || (inertia_state.velocity < 0 && delta < 0)) && dt < 0.3) {
             // Enhance the effect for consecutive scrolls in the same direction
             // Apply the multiplier only for consecutive scrolls
             // Also increase base factor here
-            velocity_factor = (60.0 + (fabs(current_velocity) / 3.0)) *  // Increased base factor
-                             (scroll_sensitivity / sensitivity_divisor) * scroll_multiplier;
+            velocity_factor = (60.0 + (fabs(inertia_state.velocity) / 3.0)) *  // Increased base factor
+                             cfg->sensitivity_scale * cfg->scroll_multiplier;
             
             if (debug_mode) {
                 printf("Consecutive scroll in same direction, applying multiplier: %.2f, velocity factor: %.2f\n", 
-                       scroll_multiplier, velocity_factor);
+                       cfg->scroll_multiplier, velocity_factor);
             }
         }
     }
     
     // Apply the velocity change
     // Calculate target velocity
-    double target_velocity = current_velocity + (double)delta * velocity_factor;
+    double ticks = whole_ticks;
+    double target_velocity = inertia_state.velocity + ticks * velocity_factor;
     
     // Smooth the velocity change - blend old and new velocities
     double blend_factor = 0.7;  // 70% new, 30% old
-    current_velocity = (target_velocity * blend_factor) + (old_velocity * (1.0 - blend_factor));
+    inertia_state.velocity = (target_velocity * blend_factor) + (old_velocity * (1.0 - blend_factor));
     
     // Cap the velocity based on screen dimensions
-    double max_velocity;
-    if (scroll_axis == SCROLL_AXIS_VERTICAL) {
-        max_velocity = screen_height * max_velocity_factor;
-    } else {
-        max_velocity = screen_width * max_velocity_factor;
-    }
+    double max_velocity = cfg->max_velocity;
     
     // Apply the cap
-    if (current_velocity > max_velocity) {
-        current_velocity = max_velocity;
+    if (inertia_state.velocity > max_velocity) {
+        inertia_state.velocity = max_velocity;
         if (debug_mode) {
             printf("Capped velocity to maximum: %.2f\n", max_velocity);
         }
-    } else if (current_velocity < -max_velocity) {
-        current_velocity = -max_velocity;
+    } else if (inertia_state.velocity < -max_velocity) {
+        inertia_state.velocity = -max_velocity;
         if (debug_mode) {
             printf("Capped velocity to minimum: %.2f\n", -max_velocity);
         }
@@ -161,311 +232,611 @@ void update_inertia(int delta) {
     
     // Update position - use a larger factor for more responsive initial movement
     // For initial scroll, don't apply multiplier
-    if (!inertia_active) {
+    if (!inertia_state.active) {
         // Initial scroll - don't apply multiplier, use increased base factor
-        current_position += (double)delta * 40.0 * (scroll_sensitivity / sensitivity_divisor); // Increased base factor
+        inertia_state.position += ticks * cfg->tick_distance;
     } else {
         // Consecutive scroll in same direction - apply multiplier, use increased base factor
-        current_position += (double)delta * 40.0 * (scroll_sensitivity / sensitivity_divisor) * // Increased base factor
-                           (((current_velocity > 0 && delta > 0) || (current_velocity < 0 && delta < 0)) ? 
-                            scroll_multiplier : 1.0);
+        inertia_state.position += ticks * cfg->tick_distance *
+                           (((inertia_state.velocity > 0 && delta > 0) || (inertia_state.velocity < 0 && delta < 0)) ? 
+                            cfg->scroll_multiplier : 1.0);
     }
     
     if (debug_mode) {
-        printf("Updated velocity: %.2f, position: %.2f\n", current_velocity, current_position);
+        printf("Updated velocity: %.2f, position: %.2f\n", inertia_state.velocity, inertia_state.position);
     }
     
-    inertia_active = 1;
+    if (!inertia_state.active) {
+        inertia_state.flings++;
+    }
+    inertia_state.active = 1;
+    publish_inertia_state();
+    config_read_unlock();
 }
 
 // Optionally, explicitly start inertia with an initial velocity.
 // NOTE: This function should also be called under state_mutex if used externally.
 void start_inertia(int initial_velocity) {
-    current_velocity = (double)initial_velocity;
-    inertia_active = 1;
-    gettimeofday(&last_time, NULL);
+    inertia_state.velocity = (double)initial_velocity;
+    if (!inertia_state.active) {
+        inertia_state.flings++;
+    }
+    inertia_state.active = 1;
+    gettimeofday(&inertia_state.last_time, NULL);
+    publish_inertia_state();
 }
 
 // Call this to cancel any ongoing inertia fling.
 // MUST be called with state_mutex HELD.
 void stop_inertia(void) {
-    current_velocity = 0.0;
-    inertia_active = 0;
-    last_time.tv_sec = 0;
-    last_time.tv_usec = 0;
+    inertia_state.velocity = 0.0;
+    inertia_state.active = 0;
+    inertia_state.last_time.tv_sec = 0;
+    inertia_state.last_time.tv_usec = 0;
+    pending_hires_units = 0;
+    publish_inertia_state();
     // Gesture ending is handled in inertia_thread_func after calling this
 }
 
-// Check if inertia is currently active (Thread-safe version)
+// Check if inertia is currently active, without taking state_mutex
 int is_inertia_active(void) {
-    pthread_mutex_lock(&state_mutex);
-    int active = inertia_active;
-    pthread_mutex_unlock(&state_mutex);
-    return active;
+    return atomic_load_explicit(&published_state.active, memory_order_acquire);
 }
 
 // Apply friction based on mouse movement
 // MUST be called with state_mutex HELD.
 void apply_mouse_friction(int movement_magnitude) {
-    if (!inertia_active || !mouse_move_drag) {
+    const ConfigSnapshot *cfg = config_read_lock();
+    if (!inertia_state.active || !cfg->mouse_move_drag) {
+        config_read_unlock();
         return;
     }
     
     // Calculate friction factor based on movement magnitude
     // Make it much gentler - small movements = very small friction
-    // Adjust friction based on sensitivity and scroll_friction
-    double friction_factor = (0.01 + (movement_magnitude * 0.0001)) * scroll_friction / sqrt(scroll_sensitivity);
+    // Scaled by sensitivity and scroll_friction when the snapshot was made
+    double friction_factor = cfg->drag_friction_base + movement_magnitude * cfg->drag_friction_per_unit;
     
     // Cap the friction factor to a lower value
-    // Adjust cap based on sensitivity and scroll_friction
-    double max_friction = 0.05 * scroll_friction / sqrt(scroll_sensitivity);
+    double max_friction = cfg->drag_friction_max;
     if (friction_factor > max_friction) friction_factor = max_friction;  // Reduced from 0.95
     
 
     // Apply the friction by reducing velocity
-    current_velocity *= (1.0 - friction_factor);
+    inertia_state.velocity *= (1.0 - friction_factor);
     
     // if (debug_mode && movement_magnitude > 10) {
     //     printf("Mouse friction: movement=%d, factor=%.3f, velocity: %.2f -> %.2f\n", 
-    //            movement_magnitude, friction_factor, old_velocity, current_velocity);
+    //            movement_magnitude, friction_factor, old_velocity, inertia_state.velocity);
     // }
 
     // Only stop inertia if velocity becomes extremely small
-    if (fabs(current_velocity) < inertia_stop_threshold) {
+    if (fabs(inertia_state.velocity) < cfg->inertia_stop_threshold) {
         if (debug_mode) {
             printf("Velocity too low (%.2f < %.2f), stopping inertia\n",
-                   current_velocity, inertia_stop_threshold);
+                   inertia_state.velocity, cfg->inertia_stop_threshold);
         }
         stop_inertia();
     }
     
     // Update the last time to prevent time-based friction from being applied immediately
-    gettimeofday(&last_time, NULL); // Already under state_mutex
+    gettimeofday(&inertia_state.last_time, NULL); // Already under state_mutex
+    publish_inertia_state();
+    config_read_unlock();
+}
+
+
+// Advance an active fling by dt seconds (caller holds state_mutex).
+// Friction decays the velocity exponentially and the position moves by the
+// exact integral of that decay, so a fling covers the same distance no
+// matter how its time is sliced into frames. Returns the distance moved.
+double advance_inertia(double dt) {
+    const ConfigSnapshot *cfg = config_read_lock();
+    const double friction = emitter->friction_coefficient();
+    double old_velocity = inertia_state.velocity;
+    double distance;
+    if (friction > 0.0) {
+        double decay = exp(-friction * dt);
+        distance = inertia_state.velocity * (1.0 - decay) / friction;
+        inertia_state.velocity *= decay;
+    } else {
+        distance = inertia_state.velocity * dt;
+    }
+    inertia_state.position += distance;
+    inertia_state.frames++;
+    if (debug_mode > 1 && fabs(old_velocity - inertia_state.velocity) > 0.1) {
+         printf("InertiaThread: Time friction (dt=%.4f): %.2f -> %.2f\n", dt, old_velocity, inertia_state.velocity);
+    }
+
+    // Check if inertia should stop due to low velocity
+    if (fabs(inertia_state.velocity) < cfg->inertia_stop_threshold) {
+        if (debug_mode) printf("InertiaThread: Velocity %.2f below threshold %.2f, stopping inertia.\n",
+                               inertia_state.velocity, cfg->inertia_stop_threshold);
+        stop_inertia(); // Resets velocity, active flag, etc. (already under mutex)
+    } else {
+        publish_inertia_state();
+    }
+    config_read_unlock();
+    return distance;
 }
 
+// Shared by all backends: converts a frame's motion (velocity*dt, in
+// position units) into whole output steps and carries the fraction over,
+// so rounding never loses or invents distance between frames.
+int scroll_integrator_step(ScrollIntegrator *integrator, double velocity, double dt, double steps_per_position) {
+    double steps = velocity * dt * steps_per_position + integrator->remainder;
+    int whole = (int)steps; // Truncate toward zero, keep the fraction
+    integrator->remainder = steps - whole;
+    return whole;
+}
+
+void scroll_integrator_reset(ScrollIntegrator *integrator) {
+    integrator->remainder = 0.0;
+}
 
 // Helper to get future time as timespec for timedwait
-static void get_future_time(struct timespec *ts, int milliseconds) {
+static void get_future_time(struct timespec *ts, long microseconds) {
     struct timeval tv;
     gettimeofday(&tv, NULL);
-    ts->tv_sec = tv.tv_sec + (milliseconds / 1000);
-    ts->tv_nsec = (tv.tv_usec * 1000) + ((milliseconds % 1000) * 1000000);
+    ts->tv_sec = tv.tv_sec + (microseconds / 1000000);
+    ts->tv_nsec = (tv.tv_usec + (microseconds % 1000000)) * 1000;
     ts->tv_sec += ts->tv_nsec / 1000000000;
     ts->tv_nsec %= 1000000000;
 }
 
+void latency_stats_add(LatencyStats *stats, double seconds) {
+    stats->count++;
+    stats->last = seconds;
+    stats->total += seconds;
+    if (seconds > stats->max) {
+        stats->max = seconds;
+    }
+}
 
-// Inertia processing thread function
-void* inertia_thread_func(void* arg) {
-    (void)arg; // Mark parameter as unused
-    printf("Inertia thread started.\n");
+void latency_stats_print(const char *stage, const LatencyStats *stats) {
+    if (stats->count == 0) {
+        return;
+    }
+    printf("%s: %lu samples, mean %.3f ms, max %.3f ms\n", stage, stats->count,
+           stats->total / stats->count * 1000.0, stats->max * 1000.0);
+}
+
+static void record_first_frame_latency(double enqueue_time) {
+    double latency = engine_clock_now() - enqueue_time;
+    latency_stats_add(&first_frame_latency, latency);
+    if (debug_mode > 1) printf("InertiaThread: First frame latency %.3f ms\n", latency * 1000.0);
+}
+
+
+// Time until the backend's output moves by one whole step at this velocity,
+// kept between the refresh_rate period and the min_refresh_rate period
+static long frame_interval_for(const ConfigSnapshot *cfg, double velocity) {
+    double steps_per_second = fabs(velocity) * emitter->steps_per_position;
+    if (steps_per_second <= 0.0) {
+        return emitter->steps_per_position > 0.0 ? cfg->max_frame_period_us : cfg->frame_period_us;
+    }
+    double interval_us = 1000000.0 / steps_per_second;
+    if (interval_us < cfg->frame_period_us) return cfg->frame_period_us;
+    if (interval_us > cfg->max_frame_period_us) return cfg->max_frame_period_us;
+    if (cfg->frame_phase_period > 0.0) {
+        // Nearest whole number of display-locked slots
+        double slot_us = cfg->frame_phase_period * 1000000.0;
+        double slots = round(interval_us / slot_us);
+        interval_us = (slots > 1.0 ? slots : 1.0) * slot_us;
+    }
+    return (long)interval_us;
+}
+
+// Offset of t from the nearest display-locked frame slot, in seconds. The
+// slots repeat every frame_phase_period on the monotonic clock; their
+// offset against the display's vblank is unknown but constant, which is
+// what keeps frames from beating against the refresh.
+static double frame_phase_offset(const ConfigSnapshot *cfg, double t) {
+    double period = cfg->frame_phase_period;
+    double offset = fmod(t, period);
+    return offset > period / 2.0 ? offset - period : offset;
+}
+
+// When the next frame of a running fling is due, in us. Fast flings run at
+// refresh_rate; as the fling slows, frames stretch to the time one output
+// step takes, so the slow tail stops waking up for frames that would not
+// move anything. With display_sync the wait ends on a frame slot.
+long inertia_frame_interval_us(void) {
+    InertiaSnapshot state;
+    inertia_snapshot(&state);
+    const ConfigSnapshot *cfg = config_read_lock();
+    long interval_us = frame_interval_for(cfg, state.velocity);
+    if (cfg->frame_phase_period > 0.0) {
+        // The slot nearest to interval_us from now; waking a little after
+        // it rather than before keeps the frame on the slot's side
+        double now = engine_clock_now();
+        double target = now + interval_us / 1000000.0;
+        double slot = target - frame_phase_offset(cfg, target);
+        interval_us = (long)((slot - now) * 1000000.0) + 1;
+        frame_slot = slot;
+    } else {
+        frame_slot = 0.0;
+    }
+    config_read_unlock();
+    return interval_us;
+}
+
+// Start the physics clock of a new fling at t, the time its first tick was
+// queued. The fling counts as having started one frame earlier, so its
+// first frame, emitted at once, carries a full frame of motion.
+static void start_physics_clock(const ConfigSnapshot *cfg, double t) {
+    physics_time = sample_time = t - cfg->frame_period_us / 1000000.0;
+    travel = previous_travel = sampled_travel = 0.0;
+    physics_history_count = 0;
+}
+
+// Run whole physics steps until physics_time reaches t (caller holds
+// state_mutex). The steps are fixed, so the trajectory depends only on
+// when ticks arrived relative to the fling's start, never on when the
+// engine happened to wake up. It stops early if the fling ends.
+static void advance_physics_to(const ConfigSnapshot *cfg, double t) {
+    if (t - physics_time > MAX_PHYSICS_CATCHUP) {
+        if (debug_mode) printf("InertiaThread: Warning - physics %.3fs behind, skipping to the last %.1fs\n",
+                               t - physics_time, MAX_PHYSICS_CATCHUP);
+        physics_time = t - MAX_PHYSICS_CATCHUP;
+    }
+    while (inertia_state.active && physics_time < t) {
+        PhysicsCheckpoint *checkpoint = &physics_history[physics_history_next];
+        checkpoint->time = physics_time;
+        checkpoint->velocity = inertia_state.velocity;
+        checkpoint->position = inertia_state.position;
+        checkpoint->travel = travel;
+        checkpoint->previous_travel = previous_travel;
+        checkpoint->frames = inertia_state.frames;
+        physics_history_next = (physics_history_next + 1) % PHYSICS_HISTORY_STEPS;
+        if (physics_history_count < PHYSICS_HISTORY_STEPS) {
+            physics_history_count++;
+        }
+
+        previous_travel = travel;
+        travel += advance_inertia(cfg->physics_step);
+        physics_time += cfg->physics_step;
+    }
+    if (!inertia_state.active && physics_time < t) {
+        // Stopped: idle whole steps up to t, so a tick that picks the
+        // fling up again lands on the same grid
+        physics_time += ceil((t - physics_time) / cfg->physics_step) * cfg->physics_step;
+        previous_travel = travel;
+    }
+}
+
+// Put the physics back on the first step boundary at or after t, the step
+// advance_physics_to(t) would have stopped on had the tick arrived in time
+// (caller holds state_mutex). Returns the physics_time to replay up to once
+// the tick is applied, or 0 if the physics has not passed that boundary or
+// it is older than the history.
+static double rewind_physics_to(const ConfigSnapshot *cfg, double t) {
+    unsigned oldest = (physics_history_next + PHYSICS_HISTORY_STEPS - physics_history_count) % PHYSICS_HISTORY_STEPS;
+    for (unsigned i = 0; i < physics_history_count; i++) {
+        const PhysicsCheckpoint *checkpoint = &physics_history[(oldest + i) % PHYSICS_HISTORY_STEPS];
+        if (checkpoint->time < t) {
+            continue;
+        }
+        if (i == 0 && checkpoint->time - cfg->physics_step >= t) {
+            return 0.0; // Older than the history; applied where the physics is
+        }
+        double resume_at = physics_time;
+        physics_time = checkpoint->time;
+        inertia_state.velocity = checkpoint->velocity;
+        inertia_state.position = checkpoint->position;
+        inertia_state.frames = checkpoint->frames;
+        travel = checkpoint->travel;
+        previous_travel = checkpoint->previous_travel;
+        physics_history_count = 0;
+        return resume_at;
+    }
+    return 0.0;
+}
+
+// Travel at time t, interpolated between the last two physics steps
+static double sample_travel(const ConfigSnapshot *cfg, double t) {
+    if (!inertia_state.active) {
+        return travel; // Ended on a step; nothing beyond it
+    }
+    double alpha = (t - (physics_time - cfg->physics_step)) / cfg->physics_step;
+    if (alpha < 0.0) alpha = 0.0;
+    if (alpha > 1.0) alpha = 1.0;
+    return previous_travel + (travel - previous_travel) * alpha;
+}
+
+// Make sure the fling clock has a valid start before the first cycle
+void inertia_engine_start(void) {
+    pthread_mutex_lock(&state_mutex);
+    if (inertia_state.last_time.tv_sec == 0 && inertia_state.last_time.tv_usec == 0) {
+         gettimeofday(&inertia_state.last_time, NULL);
+    }
+    pthread_mutex_unlock(&state_mutex);
+}
+
+// One pass of the inertia engine, without blocking: apply pending stop and
+// friction signals, fold in every queued delta, step a running fling's
+// physics up to now and hand the sampled motion to the backend. frame_due
+// is true when the caller woke for a frame (its frame timer ran out) and
+// false when input or a signal woke it. Returns when the backend wants its
+// idle() hook again in ms, -1 if never.
+long inertia_cycle(bool frame_due) {
     int dequeued_delta;
-    bool state_changed_this_cycle; // Track if queue/signal processing happened
-    int event_val_to_emit = 0; // Store event value calculated under lock
+    bool state_changed_this_cycle = false; // Track if queue/signal processing happened
+    double frame_velocity = 0.0; // Velocity and time step of the frame, captured under lock
+    double frame_dt = 0.0;
     bool should_emit_event = false; // Flag to control emission
-    // bool needs_boundary_reset_action = false; // Removed - Boundary actions handled in emitter
+    bool fling_started = false; // Inertia went from idle to active this cycle
+    double fling_enqueue_time = 0.0; // When the delta that started the fling was queued
+    // One configuration snapshot for the whole pass; the calls below nest
+    const ConfigSnapshot *cfg = config_read_lock();
 
-    // Ensure last_time is initialized before first use
+    // --- 1. Process Signals (Stop/Friction) ---
     pthread_mutex_lock(&state_mutex);
-    if (last_time.tv_sec == 0 && last_time.tv_usec == 0) {
-         gettimeofday(&last_time, NULL);
+    if (inertia_signals.stop_requested) {
+        if (inertia_state.active) {
+             stop_inertia(); // Resets velocity, active flag, last_time
+             // The backend's end() is called OUTSIDE the lock later
+        }
+        inertia_signals.stop_requested = false; // Reset flag
+        state_changed_this_cycle = true;
+    }
+    if (inertia_signals.pending_friction_magnitude > 0) {
+         if (debug_mode > 1) printf("InertiaThread: Friction request received (mag=%d).\n", inertia_signals.pending_friction_magnitude);
+         if (inertia_state.active && cfg->mouse_move_drag) {
+             // apply_mouse_friction needs state_mutex, which we hold
+             apply_mouse_friction(inertia_signals.pending_friction_magnitude);
+             physics_history_count = 0; // Not replayable
+         }
+         inertia_signals.pending_friction_magnitude = 0; // Reset magnitude
+         state_changed_this_cycle = true;
     }
     pthread_mutex_unlock(&state_mutex);
 
 
-    while (running) {
-        state_changed_this_cycle = false;
-        should_emit_event = false;
-        event_val_to_emit = 0;
-        // needs_boundary_reset_action = false; // Removed
+    // --- 1b. Process Scroll Queue ---
+    // Dequeue and process all available deltas
+    pthread_mutex_lock(&scroll_queue.mutex);
+    while (scroll_queue.count > 0) {
+        dequeued_delta = scroll_queue.deltas[scroll_queue.tail];
+        double dequeued_enqueue_time = scroll_queue.enqueue_times[scroll_queue.tail];
+        scroll_queue.tail = (scroll_queue.tail + 1) % SCROLL_QUEUE_SIZE;
+        scroll_queue.count--;
+        state_changed_this_cycle = true;
 
-        // --- 1. Wait for and Process Queue/Signals ---
-        pthread_mutex_lock(&scroll_queue.mutex);
-        // Wait only if queue is empty AND no stop/friction signal is pending
+        // Unlock queue mutex before calling update_inertia (which needs state_mutex)
+        pthread_mutex_unlock(&scroll_queue.mutex);
+
+        // --- Process the dequeued delta ---
         pthread_mutex_lock(&state_mutex);
-        bool signals_pending = stop_requested || (pending_friction_magnitude > 0);
+        if (debug_mode > 1) printf("InertiaThread: Processing delta %d\n", dequeued_delta);
+        // The tick takes effect on the physics step it was queued in
+        double tick_time = dequeued_enqueue_time > 0.0 ? dequeued_enqueue_time : engine_clock_now();
+        bool was_active = inertia_state.active;
+        if (!was_active) {
+            start_physics_clock(cfg, tick_time);
+        }
+        // A tick delivered after the physics stepped past it (the input
+        // thread ran late) goes back to its own step and the steps since
+        // are replayed, so delivery delay does not change the fling
+        double resume_at = was_active ? rewind_physics_to(cfg, tick_time) : 0.0;
+        if (was_active) {
+            // If the fling runs out before the tick, the tick picks it up
+            // again within the same gesture
+            advance_physics_to(cfg, tick_time);
+        }
+        // update_inertia needs state_mutex, which we hold
+        update_inertia(dequeued_delta); // Updates velocity, position, active flag, last_time
+        physics_history_count = 0;
+        if (resume_at > 0.0) {
+            advance_physics_to(cfg, resume_at);
+        }
+        // A hi-res delta short of a whole tick does not start a fling yet
+        if (!was_active && inertia_state.active) {
+            fling_started = true;
+            fling_enqueue_time = dequeued_enqueue_time;
+        }
         pthread_mutex_unlock(&state_mutex);
 
-        while (scroll_queue.count == 0 && !signals_pending && running) {
-            // Wait for data or timeout (e.g., 10ms) to allow inertia processing
-            struct timespec wait_time;
-            // Use a shorter wait time if inertia is active to ensure timely updates
-            pthread_mutex_lock(&state_mutex);
-            int wait_ms = inertia_active ? 5 : 10; // 5ms if active, 10ms otherwise
-            pthread_mutex_unlock(&state_mutex);
+        // Re-lock queue mutex to check loop condition
+        pthread_mutex_lock(&scroll_queue.mutex);
+    }
+    pthread_mutex_unlock(&scroll_queue.mutex); // Unlock queue mutex
 
-            get_future_time(&wait_time, wait_ms);
-            int rc = pthread_cond_timedwait(&scroll_queue.cond, &scroll_queue.mutex, &wait_time);
 
-            if (rc == ETIMEDOUT) {
-                break; // Timeout, proceed to inertia processing
-            } else if (rc != 0 && running) {
-                 perror("InertiaThread: scroll_queue pthread_cond_timedwait error");
-                 // Handle error appropriately, maybe break or continue
+    // --- 2. Process Inertia Calculation (if active) ---
+    pthread_mutex_lock(&state_mutex);
+    if (inertia_state.active) {
+        struct timeval now;
+        gettimeofday(&now, NULL);
+        if (!fling_started && (inertia_state.last_time.tv_sec != 0 || inertia_state.last_time.tv_usec != 0)) {
+            double wake_dt = time_diff_in_seconds(&inertia_state.last_time, &now);
+            frame_deadlines.checked++;
+            // Late against the interval this frame was scheduled for
+            long expected_us = frame_interval_for(cfg, inertia_state.velocity);
+            if (wake_dt * 1000000.0 > expected_us * 1.5) {
+                frame_deadlines.missed++;
             }
-            // If woken up, re-check loop condition (queue count, signals, running)
-            pthread_mutex_lock(&state_mutex);
-            signals_pending = stop_requested || (pending_friction_magnitude > 0);
-            pthread_mutex_unlock(&state_mutex);
         }
-        // Queue mutex is still held here
-
-        // --- 1a. Process Signals (Stop/Friction) ---
-        pthread_mutex_lock(&state_mutex);
-        if (stop_requested) {
-            if (inertia_active) {
-                 stop_inertia(); // Resets velocity, active flag, last_time
-                 if (use_multitouch) {
-                     // Call end_multitouch_gesture OUTSIDE the lock later
-                     should_emit_event = false; // Don't emit on stop frame
-                 }
-            }
-            stop_requested = false; // Reset flag
-            state_changed_this_cycle = true;
+        inertia_state.last_time = now;
+
+        // Step the physics past the sample time, then sample the travel at
+        // exactly that time. A late wake-up only delays the sample; the
+        // motion it carries is the same as if the wake-up had been on time
+        double sample_at = engine_clock_now();
+        advance_physics_to(cfg, sample_at);
+        double sampled = sample_travel(cfg, sample_at);
+        double distance = sampled - sampled_travel;
+        double dt = sample_at - sample_time;
+        sampled_travel = sampled;
+        sample_time = sample_at;
+
+        // Distance accumulates until the backend's output moves by a whole
+        // step, then goes out as one frame carrying the mean velocity over
+        // all of it, so backends that integrate velocity*dt still get the
+        // exact distance
+        if (fling_started) {
+            unsent_distance = unsent_dt = fling_steps = 0.0;
         }
-        if (pending_friction_magnitude > 0) {
-             if (debug_mode > 1) printf("InertiaThread: Friction request received (mag=%d).\n", pending_friction_magnitude);
-             if (inertia_active && mouse_move_drag) {
-                 // apply_mouse_friction needs state_mutex, which we hold
-                 apply_mouse_friction(pending_friction_magnitude);
-             }
-             pending_friction_magnitude = 0; // Reset magnitude
-             state_changed_this_cycle = true;
+        double steps_before = trunc(fling_steps);
+        unsent_distance += distance;
+        unsent_dt += dt;
+        fling_steps += distance * emitter->steps_per_position;
+        bool step_due = emitter->steps_per_position <= 0.0 || trunc(fling_steps) != steps_before;
+        // A pass woken by input between frame slots only folds in the
+        // delta; its motion waits for the next slot. A frame wake-up is
+        // never held, however late it runs, or the frame would be lost
+        if (!frame_due && cfg->frame_phase_period > 0.0 &&
+            fabs(frame_phase_offset(cfg, sample_at)) > cfg->frame_phase_period / 4.0) {
+            step_due = false;
         }
-        pthread_mutex_unlock(&state_mutex);
+        if (unsent_distance != 0.0 && unsent_dt > 0.0 &&
+            (step_due || fling_started || !inertia_state.active)) {
+            frame_velocity = unsent_distance / unsent_dt;
+            frame_dt = unsent_dt;
+            should_emit_event = true;
+            unsent_distance = unsent_dt = 0.0;
+        }
+        if (!inertia_state.active) {
+            state_changed_this_cycle = true; // So the gesture end below fires
+        }
+    } // end if(inertia_state.active)
 
+    // Store necessary state before releasing mutex if event emission is needed
+    // End gesture if inertia stopped this cycle
+    bool should_end_gesture = !inertia_state.active && state_changed_this_cycle;
+    bool is_active = inertia_state.active;
+    pthread_mutex_unlock(&state_mutex);
 
-        // --- 1b. Process Scroll Queue ---
-        // Dequeue and process all available deltas
-        while (scroll_queue.count > 0) {
-            dequeued_delta = scroll_queue.deltas[scroll_queue.tail];
-            scroll_queue.tail = (scroll_queue.tail + 1) % SCROLL_QUEUE_SIZE;
-            scroll_queue.count--;
-            state_changed_this_cycle = true;
+    // --- 3. Emit Frame / End Gesture (outside mutex lock) ---
+    if (fling_started) {
+         emitter->begin();
+    }
 
-            // Unlock queue mutex before calling update_inertia (which needs state_mutex)
-            pthread_mutex_unlock(&scroll_queue.mutex);
+    if (should_emit_event) {
+         if (debug_mode > 1) printf("InertiaThread: Emitting frame velocity=%.2f dt=%.4f\n", frame_velocity, frame_dt);
+         double call_start = engine_clock_now();
+         if (cfg->frame_phase_period > 0.0 && !fling_started) {
+             // The first frame of a fling goes out at once, off the grid.
+             // A timer wake-up is measured against the slot it was timed
+             // for, so one that runs a whole slot late counts as a slot
+             // missed instead of as a frame on the next slot
+             double error = (frame_due && frame_slot > 0.0) ? fabs(call_start - frame_slot)
+                                                           : fabs(frame_phase_offset(cfg, call_start));
+             latency_stats_add(&frame_phase_error, error);
+             frame_slots.checked++;
+             if (error > cfg->frame_phase_period / 4.0) {
+                 frame_slots.missed++;
+             }
+         }
+         if (emitter->frame(frame_velocity, frame_dt) < 0) {
+             fprintf(stderr, "InertiaThread: Failed to emit %s frame.\n", emitter->name);
+         }
+         latency_stats_add(&frame_call_time, engine_clock_now() - call_start);
+    }
+    if (fling_started && fling_enqueue_time > 0.0) {
+         record_first_frame_latency(fling_enqueue_time);
+    }
 
-            // --- Process the dequeued delta ---
-            pthread_mutex_lock(&state_mutex);
-            if (debug_mode > 1) printf("InertiaThread: Processing delta %d\n", dequeued_delta);
-            // update_inertia needs state_mutex, which we hold
-            update_inertia(dequeued_delta); // Updates velocity, position, active flag, last_time
-            pthread_mutex_unlock(&state_mutex);
+    if (should_end_gesture) {
+         emitter->end(); // Call outside lock
+    }
+
+    config_read_unlock();
+
+    // Give the backend a chance to finish deferred work while idle
+    return (!is_active && emitter->idle) ? emitter->idle() : -1;
+}
 
-            // Re-lock queue mutex to check loop condition
-            pthread_mutex_lock(&scroll_queue.mutex);
+// Report timing and end a gesture that was still running at shutdown
+void inertia_engine_stop(void) {
+    if (debug_mode) {
+        latency_stats_print("First frame latency", &first_frame_latency);
+        latency_stats_print("Frame hand-off (inertia thread)", &frame_call_time);
+        latency_stats_print("Frame phase error (display sync)", &frame_phase_error);
+        if (frame_slots.checked > 0) {
+            printf("Display slots missed by over a quarter slot: %lu of %lu\n",
+                   frame_slots.missed, frame_slots.checked);
         }
-        pthread_mutex_unlock(&scroll_queue.mutex); // Unlock queue mutex
+    }
+    // Ensure any final gesture is ended if inertia was still active
+    if (is_inertia_active()) {
+         emitter->end();
+    }
+}
 
+// Wake the inertia thread for a stop or friction request. It sleeps on the
+// scroll queue's condition, so every producer signals that one; call this
+// after setting the request and releasing state_mutex (the thread takes
+// scroll_queue.mutex first).
+void wake_inertia_thread(void) {
+    pthread_mutex_lock(&scroll_queue.mutex);
+    pthread_cond_signal(&scroll_queue.cond);
+    pthread_mutex_unlock(&scroll_queue.mutex);
+}
 
-        // --- 2. Process Inertia Calculation (if active) ---
-        pthread_mutex_lock(&state_mutex);
-        if (inertia_active) {
-            // Removed boundary reset timeout check - handled implicitly by emitter logic
-
-            struct timeval now;
-            gettimeofday(&now, NULL);
-            // Ensure last_time is valid before calculating dt
-            double dt = (last_time.tv_sec == 0 && last_time.tv_usec == 0) ? 0.0 : time_diff_in_seconds(&last_time, &now);
-            last_time = now; // Update last_time under mutex
-
-            // Prevent huge dt if thread was stalled
-            if (dt > 0.1) { // e.g., > 100ms
-                if (debug_mode) printf("InertiaThread: Warning - large dt detected: %.3fs, capping to 0.1s\n", dt);
-                dt = 0.1;
-            }
+// Inertia processing thread function
+void* inertia_thread_func(void* arg) {
+    (void)arg; // Mark parameter as unused
+    printf("Inertia thread started.\n");
+    long idle_wake_ms = -1; // When the backend wants its idle() hook again, -1 = never
 
-            // Apply time-based friction
-            const double friction = (use_multitouch ? (0.6 * scroll_friction / sqrt(scroll_sensitivity)) : (2.0 * scroll_friction));
-            double old_velocity = current_velocity;
-            current_velocity *= exp(-friction * dt);
-            if (debug_mode > 1 && fabs(old_velocity - current_velocity) > 0.1) {
-                 printf("InertiaThread: Time friction (dt=%.4f): %.2f -> %.2f\n", dt, old_velocity, current_velocity);
-            }
+    long period_us = config_read_lock()->frame_period_us;
+    config_read_unlock();
+    realtime_setup_thread("Inertia", period_us, period_us / 4);
+    inertia_engine_start();
 
+    while (running) {
+        // --- Wait for the queue, a signal or the next frame ---
+        pthread_mutex_lock(&scroll_queue.mutex);
+        // Wait only if queue is empty AND no stop/friction signal is pending
+        pthread_mutex_lock(&state_mutex);
+        bool signals_pending = inertia_signals.stop_requested || (inertia_signals.pending_friction_magnitude > 0);
+        pthread_mutex_unlock(&state_mutex);
 
-            // Calculate position delta / event value
-            if (use_multitouch) {
-                // Calculate potential position change based on current velocity and time delta
-                double position_delta = current_velocity * dt; // Use the velocity directly (units/sec * sec)
-                current_position += position_delta; // Update position based on inertia
-
-                // Boundary check and clamping are now handled in emit_two_finger_scroll_event
-                event_val_to_emit = (int)round(position_delta);
-                if (event_val_to_emit != 0) {
-                    should_emit_event = true;
-                }
-            } else {
-                // Logic from process_inertia (Wheel events) - Remains the same
-                event_val_to_emit = (int)round(current_velocity);
-                if (event_val_to_emit != 0) {
-                     should_emit_event = true;
-                }
-                // Note: process_inertia didn't update current_position, add if needed
+        bool frame_due = false; // Woken by the frame timeout rather than input
+        while (scroll_queue.count == 0 && !signals_pending && running) {
+            // Wait for data or until the next frame is due. While a fling
+            // runs, frames are paced by inertia_frame_interval_us(), between
+            // refresh_rate and min_refresh_rate. When idle we only wake
+            // up for new deltas (enqueue signals the cond right away) or to
+            // notice shutdown, so a new scroll never waits behind a sleep.
+            struct timespec wait_time;
+            bool active = is_inertia_active();
+            long wait_us = 100000;
+            if (active) {
+                wait_us = inertia_frame_interval_us();
             }
-
-             // Check if inertia should stop due to low velocity
-            if (fabs(current_velocity) < inertia_stop_threshold) {
-                if (debug_mode) printf("InertiaThread: Velocity %.2f below threshold %.2f, stopping inertia.\n",
-                                       current_velocity, inertia_stop_threshold);
-                stop_inertia(); // Resets velocity, active flag, etc. (already under mutex)
-                should_emit_event = false; // Don't emit event on the frame we stop
-                // Gesture end signal is handled below based on state_changed_this_cycle
+            if (!active && idle_wake_ms >= 0 && idle_wake_ms * 1000 < wait_us) {
+                wait_us = idle_wake_ms > 0 ? idle_wake_ms * 1000 : 1000;
             }
-        } // end if(inertia_active)
-
-        // Store necessary state before releasing mutex if event emission is needed
-        // End gesture if inertia stopped this cycle
-        bool should_end_gesture = use_multitouch && !inertia_active && state_changed_this_cycle;
-        pthread_mutex_unlock(&state_mutex);
 
-        // --- 3. Emit Event / End Gesture (outside mutex lock) ---
-        // Removed boundary reset action block - handled in emitter
-
-        if (should_emit_event && event_val_to_emit != 0) {
-             if (debug_mode > 1) printf("InertiaThread: Emitting event value %d\n", event_val_to_emit);
-             if (use_multitouch) {
-                 // emit_two_finger_scroll_event should NOT access shared state now
-                 if (emit_two_finger_scroll_event(event_val_to_emit) < 0) {
-                     fprintf(stderr, "InertiaThread: Failed to emit multitouch scroll event.\n");
-                     // Optionally signal stop on error? Be careful of loops.
-                     // signal_stop_request();
-                 }
-             } else {
-                 if (emit_scroll_event(event_val_to_emit) < 0) {
-                     fprintf(stderr, "InertiaThread: Failed to emit scroll event.\n");
-                     // signal_stop_request();
-                 }
-             }
-        }
+            get_future_time(&wait_time, wait_us);
+            int rc = pthread_cond_timedwait(&scroll_queue.cond, &scroll_queue.mutex, &wait_time);
 
-        if (should_end_gesture) {
-             end_multitouch_gesture(); // Call outside lock
+            if (rc == ETIMEDOUT) {
+                frame_due = true;
+                break; // Timeout, proceed to inertia processing
+            } else if (rc != 0 && running) {
+                 perror("InertiaThread: scroll_queue pthread_cond_timedwait error");
+                 // Handle error appropriately, maybe break or continue
+            }
+            // If woken up, re-check loop condition (queue count, signals, running)
+            pthread_mutex_lock(&state_mutex);
+            signals_pending = inertia_signals.stop_requested || (inertia_signals.pending_friction_magnitude > 0);
+            pthread_mutex_unlock(&state_mutex);
         }
+        pthread_mutex_unlock(&scroll_queue.mutex);
 
-        // --- 4. Sleep if Idle ---
-        // If no state changed and inertia isn't active, sleep a bit longer
-        pthread_mutex_lock(&state_mutex);
-        bool is_active = inertia_active;
-        pthread_mutex_unlock(&state_mutex);
-        if (!state_changed_this_cycle && !is_active) {
-             usleep(20000); // Sleep 20ms if completely idle
-        } else if (!state_changed_this_cycle && is_active) {
-             // If inertia is active but no input/signals, rely on timedwait timeout
-             // or add a very small sleep if timedwait is too long
-             usleep(1000); // Optional 1ms sleep during active inertia
-        }
+        idle_wake_ms = inertia_cycle(frame_due);
+        period_us = config_read_lock()->frame_period_us;
+        config_read_unlock();
+        realtime_update_thread(period_us, period_us / 4);
 
+        // No sleep here: the timedwait above blocks while idle and paces
+        // frames while a fling is active
     } // end while(running)
 
     printf("Inertia thread exiting.\n");
-    // Ensure any final gesture is ended if multitouch was used and active
-    pthread_mutex_lock(&state_mutex);
-    bool final_gesture_end = use_multitouch && inertia_active;
-    pthread_mutex_unlock(&state_mutex);
-    if (final_gesture_end) {
-         end_multitouch_gesture();
-    }
+    inertia_engine_stop();
     return NULL;
 }
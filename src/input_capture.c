@@ -8,10 +8,14 @@
 #include <limits.h>
 #include <pthread.h> // Add this include
 #include <errno.h>   // Add this include for EAGAIN
+#include <sys/time.h>
 #include "momentum_mouse.h"
 
+#define INPUT_PERIOD_US 1000 // Deadline period of the input thread: one report of a 1 kHz mouse
+
 static struct libevdev *evdev = NULL;
 static char *mouse_device_path = NULL;
+static bool source_has_hires = false; // Source reports the captured axis in 1/120 detents
 // static int inertia_already_stopped = 0; // Removed
 
 // Helper to extract the event number from a device node string (e.g. "/dev/input/event5")
@@ -90,12 +94,6 @@ int initialize_input_capture(const char *device_override) {
         return -1;
     }
 
-    // Note: We no longer use EVIOCGRAB as it blocks all events
-    // Instead, we'll selectively handle events in capture_input_event
-    if (debug_mode) {
-        printf("Using selective event handling (grab_device=%d)\n", grab_device);
-    }
-
     int rc = libevdev_new_from_fd(fd, &evdev);
     if (rc < 0) {
         fprintf(stderr, "Failed to initialize libevdev: %s\n", strerror(-rc));
@@ -104,17 +102,50 @@ int initialize_input_capture(const char *device_override) {
         close(fd);
         return -1;
     }
+
+    // Grab the device exclusively and replay everything we don't consume on a
+    // cloned passthrough device. The clone is created before grabbing so the
+    // pointer never goes dead if either step fails.
+    if (grab_device) {
+        if (setup_passthrough_device(evdev) < 0) {
+            fprintf(stderr, "Warning: Could not create passthrough device, not grabbing %s\n", mouse_device_path);
+            grab_device = 0;
+        } else if (libevdev_grab(evdev, LIBEVDEV_GRAB) < 0) {
+            perror("Warning: Could not grab mouse device");
+            destroy_passthrough_device();
+            grab_device = 0;
+        }
+    }
+    if (debug_mode) {
+        printf("Exclusive grab %s\n", grab_device ? "enabled" : "disabled");
+    }
+
+    // Hi-res mice send both axes; we then capture the hi-res one and treat
+    // the legacy detents as duplicates
+    source_has_hires = libevdev_has_event_code(evdev, EV_REL,
+        scroll_axis == SCROLL_AXIS_HORIZONTAL ? REL_HWHEEL_HI_RES : REL_WHEEL_HI_RES);
+    if (debug_mode) {
+        printf("Source wheel resolution: %s\n", source_has_hires ? "hi-res (1/120 detent)" : "detents");
+    }
     return 0;
 }
 
 
 // --- Start Thread Helper Functions ---
 
+// Check for the hi-res companion of the wheel axis we capture
+static bool is_captured_hires_wheel(const struct input_event *ev, ScrollAxis axis) {
+    if (ev->type != EV_REL) return false;
+    return (axis == SCROLL_AXIS_VERTICAL && ev->code == REL_WHEEL_HI_RES) ||
+           (axis == SCROLL_AXIS_HORIZONTAL && ev->code == REL_HWHEEL_HI_RES);
+}
+
 // Function to add delta to the queue (thread-safe)
 static void enqueue_scroll_delta(int delta) {
     pthread_mutex_lock(&scroll_queue.mutex);
     if (scroll_queue.count < SCROLL_QUEUE_SIZE) {
         scroll_queue.deltas[scroll_queue.head] = delta;
+        scroll_queue.enqueue_times[scroll_queue.head] = engine_clock_now();
         scroll_queue.head = (scroll_queue.head + 1) % SCROLL_QUEUE_SIZE;
         scroll_queue.count++;
         // Signal the inertia thread that new data is available
@@ -131,24 +162,25 @@ static void enqueue_scroll_delta(int delta) {
 // Function to signal stop (thread-safe)
 static void signal_stop_request() {
     pthread_mutex_lock(&state_mutex);
-    stop_requested = true;
-    pthread_cond_signal(&state_cond); // Signal inertia thread
+    inertia_signals.stop_requested = true;
     pthread_mutex_unlock(&state_mutex);
+    wake_inertia_thread();
 }
 
 // Function to signal friction (thread-safe)
-static void signal_friction_request(int magnitude) {
-    pthread_mutex_lock(&state_mutex);
+static void signal_friction_request(const ConfigSnapshot *cfg, int magnitude) {
     // Only signal if dragging is enabled and magnitude is significant
-    if (mouse_move_drag && magnitude > 0) {
-         // Accumulate or just set the latest? Let's set latest for simplicity.
-         // Use max to handle potentially rapid small movements resulting in larger friction signal
-         if (magnitude > pending_friction_magnitude) {
-             pending_friction_magnitude = magnitude;
-         }
-         pthread_cond_signal(&state_cond); // Signal inertia thread
+    if (!cfg->mouse_move_drag || magnitude <= 0) {
+        return;
+    }
+    pthread_mutex_lock(&state_mutex);
+    // Accumulate or just set the latest? Let's set latest for simplicity.
+    // Use max to handle potentially rapid small movements resulting in larger friction signal
+    if (magnitude > inertia_signals.pending_friction_magnitude) {
+        inertia_signals.pending_friction_magnitude = magnitude;
     }
     pthread_mutex_unlock(&state_mutex);
+    wake_inertia_thread();
 }
 
 // --- End Thread Helper Functions ---
@@ -157,7 +189,13 @@ static void signal_friction_request(int magnitude) {
 // Clean up resources used by input capture
 void cleanup_input_capture(void) {
     if (evdev) {
+        if (grab_device) {
+            libevdev_grab(evdev, LIBEVDEV_UNGRAB);
+        }
+        destroy_passthrough_device();
+        int fd = libevdev_get_fd(evdev);
         libevdev_free(evdev);
+        close(fd);
         evdev = NULL;
     }
     if (mouse_device_path) {
@@ -167,129 +205,172 @@ void cleanup_input_capture(void) {
 }
 
 
+// The kernel stamps source events with the wall clock
+static void check_input_deadline(const struct input_event *ev, const ConfigSnapshot *cfg) {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    long late_us = (now.tv_sec - (long)ev->input_event_sec) * 1000000L +
+                   (now.tv_usec - (long)ev->input_event_usec);
+    input_deadlines.checked++;
+    if (late_us > cfg->frame_period_us) {
+        input_deadlines.missed++;
+    }
+}
+
+// Route one event from the source mouse: capture scroll, signal stop and
+// friction, and mirror everything else to the passthrough device.
+static void handle_input_event(struct input_event *ev, const ConfigSnapshot *cfg) {
+    bool excluded = is_current_app_excluded();
+
+    // Scroll Wheel Event (legacy detents or their hi-res companion)
+    bool legacy_wheel = ev->type == EV_REL &&
+        ((cfg->scroll_axis == SCROLL_AXIS_VERTICAL && ev->code == REL_WHEEL) ||
+         (cfg->scroll_axis == SCROLL_AXIS_HORIZONTAL && ev->code == REL_HWHEEL));
+    if (legacy_wheel || is_captured_hires_wheel(ev, cfg->scroll_axis)) {
+        if (excluded) {
+            // Pass through natively. We ignore momentum logic entirely
+            emitter->passthrough(ev);
+        } else if (legacy_wheel == source_has_hires) {
+            // Consumed: the other axis of a hi-res mouse carries this motion
+        } else {
+            // The queue is in 1/WHEEL_HIRES_UNITS of a detent
+            int delta = legacy_wheel ? ev->value * WHEEL_HIRES_UNITS : ev->value;
+            if (debug_mode) {
+                debug_log("InputThread: Captured %s scroll event: %d/%d\n",
+                       (cfg->scroll_axis == SCROLL_AXIS_HORIZONTAL) ? "horizontal" : "vertical",
+                       delta, WHEEL_HIRES_UNITS);
+            }
+            check_input_deadline(ev, cfg);
+            enqueue_scroll_delta(delta); // Enqueue delta
+            // Consumed: the wheel event is not forwarded to the passthrough device
+        }
+    }
+    // Escape Key Event
+    else if (ev->type == EV_KEY && ev->code == KEY_ESC && ev->value == 1) {
+         if (debug_mode) printf("InputThread: Escape key pressed, signaling stop\n");
+         signal_stop_request();
+         emitter->passthrough(ev); // Pass through key event
+    }
+    // Mouse Movement Event
+    else if (ev->type == EV_REL && (ev->code == REL_X || ev->code == REL_Y)) {
+        int movement = abs(ev->value);
+        // Signal friction based on movement if enabled
+        if (movement > 0) {
+             signal_friction_request(cfg, movement);
+             if (debug_mode && movement > 5 && cfg->mouse_move_drag) {
+               //   printf("InputThread: Mouse movement: %d, signaling friction\n", movement);
+             }
+        }
+        // Signal stop for very large movements (optional, friction might be enough)
+        if (movement > 50) { // Threshold for stopping
+           //   if (debug_mode) printf("InputThread: Large mouse movement: %d, signaling stop\n", movement);
+             signal_stop_request();
+        }
+        emitter->passthrough(ev); // Pass through mouse movement
+    }
+    // Mouse Button Click Event
+    else if (ev->type == EV_KEY && (ev->code == BTN_LEFT || ev->code == BTN_RIGHT || ev->code == BTN_MIDDLE) && ev->value == 1) {
+         if (debug_mode) printf("InputThread: Mouse button clicked, signaling stop\n");
+         signal_stop_request();
+         emitter->passthrough(ev); // Pass through button event
+    }
+    // Everything else is mirrored by the passthrough device
+    else {
+        emitter->passthrough(ev);
+    }
+}
+
+int input_capture_fd(void) {
+    return evdev ? libevdev_get_fd(evdev) : -1;
+}
+
+// Handle every event the kernel has queued for the source device. Returns
+// -1 on a read error, 0 once the device would block.
+int read_input_events(void) {
+    struct input_event ev;
+    int rc;
+    const ConfigSnapshot *cfg = config_read_lock(); // One snapshot per batch
+    do {
+        rc = libevdev_next_event(evdev, LIBEVDEV_READ_FLAG_NORMAL, &ev);
+        if (rc == LIBEVDEV_READ_STATUS_SUCCESS) {
+            handle_input_event(&ev, cfg);
+        } else if (rc == LIBEVDEV_READ_STATUS_SYNC) {
+            // Events were dropped by the kernel. ev is SYN_DROPPED, which
+            // discards the partial passthrough frame; then replay the state
+            // deltas libevdev computed until the device is back in sync.
+            if (debug_mode > 1) printf("InputThread: Received SYN_DROPPED, resyncing\n");
+            emitter->passthrough(&ev);
+            while (libevdev_next_event(evdev, LIBEVDEV_READ_FLAG_SYNC, &ev) == LIBEVDEV_READ_STATUS_SYNC) {
+                emitter->passthrough(&ev);
+            }
+        } else if (rc != -EAGAIN) {
+            // Error reading event
+            perror("InputThread: Error reading input event");
+            config_read_unlock();
+            return -1;
+        }
+    } while (rc == LIBEVDEV_READ_STATUS_SUCCESS || rc == LIBEVDEV_READ_STATUS_SYNC);
+    config_read_unlock();
+    return 0;
+}
+
 // Input thread function
 void* input_thread_func(void* arg) {
     (void)arg; // Mark parameter as unused
     printf("Input thread started.\n");
-    struct input_event ev; // Move ev declaration outside the loop
 
     // Ensure evdev is initialized
     if (!evdev) {
         fprintf(stderr, "InputThread: Error - evdev not initialized.\n");
-        running = 0; // Signal other threads to stop
+        request_shutdown(); // Signal other threads to stop
         return NULL;
     }
 
+    int passthrough_backlog = 0; // Frames the passthrough device has not taken yet
+
+    realtime_setup_thread("Input", INPUT_PERIOD_US, INPUT_PERIOD_US / 10);
+
+    int fd = libevdev_get_fd(evdev);
+
     while (running) {
-        // Use blocking read with a timeout to allow checking 'running' flag periodically
-        // Or use non-blocking with a small sleep. Let's try blocking with timeout.
-        // Get the underlying file descriptor
-        int fd = libevdev_get_fd(evdev);
+        // Wait for events, or for the shutdown eventfd that wakes every
+        // thread as soon as the daemon stops. Retry soon while the
+        // passthrough device is backed up.
         fd_set read_fds;
         struct timeval timeout;
-        int select_ret;
+        int max_fd = fd > shutdown_event_fd ? fd : shutdown_event_fd;
 
         FD_ZERO(&read_fds);
         FD_SET(fd, &read_fds);
-
-        // Set timeout (e.g., 100ms)
+        if (shutdown_event_fd >= 0) {
+            FD_SET(shutdown_event_fd, &read_fds);
+        }
         timeout.tv_sec = 0;
-        timeout.tv_usec = 100000; // 100ms
+        timeout.tv_usec = passthrough_backlog > 0 ? 2000 : 100000;
 
-        select_ret = select(fd + 1, &read_fds, NULL, NULL, &timeout);
+        int select_ret = select(max_fd + 1, &read_fds, NULL, NULL, &timeout);
 
         if (select_ret < 0) {
             // Error in select
             if (errno == EINTR) continue; // Interrupted by signal, check running flag
             perror("InputThread: select error");
-            running = 0;
+            request_shutdown();
             break;
-        } else if (select_ret == 0) {
-            // Timeout - no event, loop to check running flag
+        } else if (select_ret == 0 || !FD_ISSET(fd, &read_fds)) {
+            // Timeout or shutdown - no event, retry held-back frames and check running flag
+            if (passthrough_backlog > 0) {
+                passthrough_backlog = emitter->flush();
+            }
             continue;
         }
 
-        // Event is available, read it using non-blocking flag now
-        int rc = libevdev_next_event(evdev, LIBEVDEV_READ_FLAG_NORMAL, &ev);
-
-        if (rc == LIBEVDEV_READ_STATUS_SUCCESS) {
-             // --- Event Handling Logic (adapted from capture_input_event) ---
-             
-             bool excluded = is_current_app_excluded();
-
-             // Scroll Wheel Event
-             if (ev.type == EV_REL &&
-                 ((scroll_axis == SCROLL_AXIS_VERTICAL && ev.code == REL_WHEEL) ||
-                  (scroll_axis == SCROLL_AXIS_HORIZONTAL && ev.code == REL_HWHEEL))) {
-                 
-                 if (excluded) {
-                     // Pass through natively. We ignore momentum logic entirely
-                     emit_passthrough_event(&ev);
-                 } else {
-                     if (debug_mode) {
-                         debug_log("InputThread: Captured %s scroll event: %d\n",
-                                (scroll_axis == SCROLL_AXIS_HORIZONTAL) ? "horizontal" : "vertical",
-                                ev.value);
-                     }
-                     enqueue_scroll_delta(ev.value); // Enqueue delta
-
-                     // If grab_device is enabled, don't pass through the scroll event
-                     if (!grab_device) {
-                         // Pass through a zeroed event if not grabbing to avoid double-scroll
-                         struct input_event dummy_ev = ev;
-                         dummy_ev.value = 0;
-                         emit_passthrough_event(&dummy_ev);
-                     }
-                 }
-                 // No return needed, loop continues
-             }
-             // Escape Key Event
-             else if (ev.type == EV_KEY && ev.code == KEY_ESC && ev.value == 1) {
-                  if (debug_mode) printf("InputThread: Escape key pressed, signaling stop\n");
-                  signal_stop_request();
-                  emit_passthrough_event(&ev); // Pass through key event
-             }
-             // Mouse Movement Event
-             else if (ev.type == EV_REL && (ev.code == REL_X || ev.code == REL_Y)) {
-                 int movement = abs(ev.value);
-                 // Signal friction based on movement if enabled
-                 if (movement > 0) {
-                      signal_friction_request(movement);
-                      if (debug_mode && movement > 5 && mouse_move_drag) {
-                        //   printf("InputThread: Mouse movement: %d, signaling friction\n", movement);
-                      }
-                 }
-                 // Signal stop for very large movements (optional, friction might be enough)
-                 if (movement > 50) { // Threshold for stopping
-                    //   if (debug_mode) printf("InputThread: Large mouse movement: %d, signaling stop\n", movement);
-                      signal_stop_request();
-                 }
-                 emit_passthrough_event(&ev); // Pass through mouse movement
-             }
-             // Mouse Button Click Event
-             else if (ev.type == EV_KEY && (ev.code == BTN_LEFT || ev.code == BTN_RIGHT || ev.code == BTN_MIDDLE) && ev.value == 1) {
-                  if (debug_mode) printf("InputThread: Mouse button clicked, signaling stop\n");
-                  signal_stop_request();
-                  emit_passthrough_event(&ev); // Pass through button event
-             }
-             // Other relevant events to pass through
-             else if (ev.type == EV_REL || ev.type == EV_KEY || ev.type == EV_SYN) {
-                 // Pass through other relevant events
-                 emit_passthrough_event(&ev);
-             }
-        } else if (rc == LIBEVDEV_READ_STATUS_SYNC) {
-            // Handle sync event if necessary, usually just pass through
-             if (debug_mode > 1) printf("InputThread: Received SYNC event\n");
-             // Potentially pass through SYN events as well
-             emit_passthrough_event(&ev);
-        } else if (rc == -EAGAIN) {
-            // Should not happen often with select(), but handle anyway
-            // No events available, loop will continue
-        } else {
-            // Error reading event
-            perror("InputThread: Error reading input event");
-            running = 0; // Stop the application on error
+        // Drain everything the kernel has queued, then flush the completed
+        // passthrough frames with a single writev
+        if (read_input_events() < 0) {
+            request_shutdown(); // Stop the application on error
         }
+
+        passthrough_backlog = emitter->flush();
     }
 
     printf("Input thread exiting.\n");
@@ -9,6 +9,11 @@
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <sys/stat.h>
+#include <sys/resource.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <poll.h>
+#include <stdint.h>
 #include <errno.h>
 #include "momentum_mouse.h"
 #include <linux/limits.h>
@@ -42,14 +47,15 @@ int is_current_app_excluded(void) {
 }
 
 #define SOCKET_PATH "/run/momentum_mouse.sock"
-void* socket_thread_func(void* arg) {
-    (void)arg;
+
+// Create the datagram socket the window listener reports focus changes to
+int open_focus_socket(void) {
     struct sockaddr_un addr;
     
-    socket_fd = socket(AF_UNIX, SOCK_DGRAM, 0);
-    if (socket_fd == -1) {
+    int fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if (fd == -1) {
         perror("unix socket error");
-        return NULL;
+        return -1;
     }
     
     unlink(SOCKET_PATH);
@@ -57,16 +63,62 @@ void* socket_thread_func(void* arg) {
     addr.sun_family = AF_UNIX;
     strncpy(addr.sun_path, SOCKET_PATH, sizeof(addr.sun_path) - 1);
     
-    if (bind(socket_fd, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
         perror("unix socket bind error");
-        close(socket_fd);
-        return NULL;
+        close(fd);
+        return -1;
     }
     
     // Give everybody read/write access to the socket
     chmod(SOCKET_PATH, 0666);
-    
+    return fd;
+}
+
+// Read one focus message and halt inertia if the new app is excluded
+void handle_focus_message(int fd) {
     char buffer[256];
+    int bytes_received = recvfrom(fd, buffer, sizeof(buffer) - 1, 0, NULL, NULL);
+    if (bytes_received <= 0) {
+        return;
+    }
+    buffer[bytes_received] = '\0';
+    // Clean up trailing newline
+    if (buffer[bytes_received - 1] == '\n') buffer[bytes_received - 1] = '\0';
+    
+    pthread_mutex_lock(&active_app_mutex);
+    strncpy(current_active_app, buffer, sizeof(current_active_app) - 1);
+    current_active_app[sizeof(current_active_app) - 1] = '\0';
+    pthread_mutex_unlock(&active_app_mutex);
+    
+    if (debug_mode) {
+        debug_log("Socket received active app: %s\n", current_active_app);
+    }
+    
+    // If it transitioned to an excluded app, immediately halt inertia
+    if (is_current_app_excluded()) {
+        pthread_mutex_lock(&state_mutex);
+        stop_inertia();
+        inertia_signals.stop_requested = true;
+        pthread_mutex_unlock(&state_mutex);
+        wake_inertia_thread();
+        if (debug_mode) {
+            debug_log("Inertia halted due to excluded app focus.\n");
+        }
+    }
+}
+
+void close_focus_socket(int fd) {
+    close(fd);
+    unlink(SOCKET_PATH);
+}
+
+void* socket_thread_func(void* arg) {
+    (void)arg;
+    socket_fd = open_focus_socket();
+    if (socket_fd == -1) {
+        return NULL;
+    }
+    
     while (running) {
         struct timeval tv;
         tv.tv_sec = 1; // 1 second timeout
@@ -75,50 +127,30 @@ void* socket_thread_func(void* arg) {
         fd_set rfds;
         FD_ZERO(&rfds);
         FD_SET(socket_fd, &rfds);
+        int max_fd = socket_fd;
+        if (shutdown_event_fd >= 0) {
+            // Wakes us at once on shutdown instead of after the timeout
+            FD_SET(shutdown_event_fd, &rfds);
+            if (shutdown_event_fd > max_fd) max_fd = shutdown_event_fd;
+        }
         
-        int retval = select(socket_fd + 1, &rfds, NULL, NULL, &tv);
+        int retval = select(max_fd + 1, &rfds, NULL, NULL, &tv);
         if (retval == -1) {
             if (errno == EINTR) continue;
             perror("unix socket select error");
             break;
-        } else if (retval > 0) {
-            int bytes_received = recvfrom(socket_fd, buffer, sizeof(buffer) - 1, 0, NULL, NULL);
-            if (bytes_received > 0) {
-                buffer[bytes_received] = '\0';
-                // Clean up trailing newline
-                if (buffer[bytes_received - 1] == '\n') buffer[bytes_received - 1] = '\0';
-                
-                pthread_mutex_lock(&active_app_mutex);
-                strncpy(current_active_app, buffer, sizeof(current_active_app) - 1);
-                current_active_app[sizeof(current_active_app) - 1] = '\0';
-                pthread_mutex_unlock(&active_app_mutex);
-                
-                if (debug_mode) {
-                    debug_log("Socket received active app: %s\n", current_active_app);
-                }
-                
-                // If it transitioned to an excluded app, immediately halt inertia
-                if (is_current_app_excluded()) {
-                    pthread_mutex_lock(&state_mutex);
-                    stop_inertia();
-                    stop_requested = true;
-                    pthread_cond_signal(&state_cond);
-                    pthread_mutex_unlock(&state_mutex);
-                    if (debug_mode) {
-                        debug_log("Inertia halted due to excluded app focus.\n");
-                    }
-                }
-            }
+        } else if (retval > 0 && FD_ISSET(socket_fd, &rfds)) {
+            handle_focus_message(socket_fd);
         }
     }
     
-    close(socket_fd);
-    unlink(SOCKET_PATH);
+    close_focus_socket(socket_fd);
     return NULL;
 }
 
 // Global configuration variables
 int use_multitouch = 1;
+char *backend_name = NULL; // Set by --backend or the backend config key
 int grab_device = 1;  // Default to grabbing for better performance
 int daemon_mode = 0;  // Default to foreground mode
 int mouse_move_drag = 1; // Default to enabled - mouse movement slows scrolling
@@ -132,7 +164,16 @@ double scroll_friction = 2.0;     // Default friction
 double max_velocity_factor = 0.8; // Default max velocity (80% of screen dimension)
 double sensitivity_divisor = 0.3; // Default sensitivity divisor
 double resolution_multiplier = 10.0; // Default resolution multiplier
+double touch_surface_factor = 8.0; // Virtual touch surface size relative to the screen
+int touch_prearm = 1;     // Touch down with the first motion frame of a fling
+int touch_linger_ms = 0;  // Lift the contact as soon as a fling ends
+int use_emitter_thread = 0; // Write from the inertia and input threads directly
+int single_thread_mode = 0; // Run input, inertia and focus socket on their own threads
 int refresh_rate = 200; // Default refresh rate (200 Hz)
+int min_refresh_rate = 30; // Slow fling tails may drop to 30 Hz
+int display_sync = 1; // Round the frame rate to a multiple of the display refresh
+int physics_rate = 1000; // Physics steps at 1 kHz whatever the frame rate
+double display_refresh_hz = 0.0; // Detected at startup unless configured
 double inertia_stop_threshold = 1.0; // Default stop threshold
 const char *config_file_override = NULL;  // Config file override path
 char *device_override = NULL;  // Device path override
@@ -149,37 +190,59 @@ pthread_mutex_t state_mutex;
 pthread_cond_t state_cond;
 
 // Flags for communication between threads (protected by state_mutex)
-bool stop_requested = false;
-int pending_friction_magnitude = 0;
+InertiaSignals inertia_signals = {0};
 
 // Thread IDs
 pthread_t input_thread_id;
 pthread_t inertia_thread_id;
 
-// Signal handler function
-void handle_signal(int signal) {
-    if (signal == SIGINT || signal == SIGTERM) {
-        debug_log("\nSignal %d received, stopping...\n", signal);
-        running = 0; // Set the global flag to signal threads to stop
+// Shutdown wake-up: written once, stays readable so every waiter sees it
+int shutdown_event_fd = -1;
 
-        // Signal the inertia thread to wake up if it's waiting on the scroll queue condition
-        pthread_mutex_lock(&scroll_queue.mutex);
-        pthread_cond_signal(&scroll_queue.cond);
-        pthread_mutex_unlock(&scroll_queue.mutex);
+// Stop every thread promptly. Called from normal thread context only;
+// SIGINT/SIGTERM are read from a signalfd, never handled asynchronously.
+void request_shutdown(void) {
+    running = 0; // Set the global flag to signal threads to stop
+    if (shutdown_event_fd >= 0) {
+        uint64_t one = 1;
+        if (write(shutdown_event_fd, &one, sizeof(one)) < 0 && debug_mode) {
+            perror("Shutdown eventfd write");
+        }
+    }
 
-        // Signal the inertia thread again if it's waiting on the state condition
-        pthread_mutex_lock(&state_mutex);
-        pthread_cond_signal(&state_cond);
-        pthread_mutex_unlock(&state_mutex);
+    // Signal the inertia thread to wake up if it's waiting on the scroll queue condition
+    pthread_mutex_lock(&scroll_queue.mutex);
+    pthread_cond_signal(&scroll_queue.cond);
+    pthread_mutex_unlock(&scroll_queue.mutex);
 
+    // Signal the inertia thread again if it's waiting on the state condition
+    pthread_mutex_lock(&state_mutex);
+    pthread_cond_signal(&state_cond);
+    pthread_mutex_unlock(&state_mutex);
+}
 
-        // Signal the input thread (if it's blocked on select) - This is harder,
-        // select might need a self-pipe trick or similar to interrupt cleanly.
-        // For now, rely on the running flag check after select timeout/event.
-        // Input thread also checks 'running' flag periodically.
+// Block SIGINT/SIGTERM in this and every thread created after it and
+// return a signalfd that receives them instead
+static int open_signal_fd(void) {
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    if (pthread_sigmask(SIG_BLOCK, &signals, NULL) != 0) {
+        return -1;
     }
+    return signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
 }
 
+// Read one pending signal; returns its number, 0 if none was pending
+int read_shutdown_signal(int signal_fd) {
+    struct signalfd_siginfo info;
+    if (read(signal_fd, &info, sizeof(info)) != (ssize_t)sizeof(info)) {
+        return 0;
+    }
+    debug_log("\nSignal %u received, stopping...\n", info.ssi_signo);
+    return (int)info.ssi_signo;
+}
 
 // Implementation of debug_log function
 void debug_log(const char *format, ...) {
@@ -202,6 +265,86 @@ void debug_log(const char *format, ...) {
     va_end(args);
 }
 
+// Run the daemon on its input, inertia and socket threads until a signal or
+// a worker stops them. Returns -1 if a required thread could not be started.
+static int run_worker_threads(int signal_fd) {
+    // --- Create Threads ---
+    // Thread IDs
+    pthread_t input_thread_id;
+    pthread_t inertia_thread_id;
+
+    debug_log("Starting threads...\n");
+    if (pthread_create(&input_thread_id, NULL, input_thread_func, NULL) != 0) {
+        perror("Error creating input thread");
+        return -1; // main() cleans up
+    }
+    if (pthread_create(&inertia_thread_id, NULL, inertia_thread_func, NULL) != 0) {
+        perror("Error creating inertia thread");
+        // Signal input thread to stop and join it
+        request_shutdown();
+        debug_log("Waiting for input thread to exit after inertia thread creation failure...\n");
+        pthread_join(input_thread_id, NULL); // Wait for input thread to stop
+        return -1; // main() cleans up
+    }
+    
+    // Start the unix socket thread
+    if (pthread_create(&socket_thread_id, NULL, socket_thread_func, NULL) != 0) {
+        perror("Warning: Error creating socket thread");
+        // We can continue running without the socket thread if necessary
+    }
+    
+    debug_log("Threads started successfully.\n");
+    // --- End Thread Creation ---
+
+    // Sleep until a signal arrives or a worker asks for shutdown; power
+    // supply changes are handled here too (poll skips a negative fd)
+    struct pollfd wait_fds[3] = {
+        { .fd = signal_fd, .events = POLLIN },
+        { .fd = shutdown_event_fd, .events = POLLIN },
+        { .fd = power_profile_fd(), .events = POLLIN },
+    };
+    while (running) {
+        if (poll(wait_fds, 3, -1) < 0 && errno != EINTR) {
+            perror("Error waiting for shutdown");
+            break;
+        }
+        if (wait_fds[2].revents & POLLIN) {
+            power_profile_handle();
+        }
+        if (read_shutdown_signal(signal_fd) != 0) {
+            request_shutdown();
+        }
+    }
+
+    // --- Wait for Threads to Complete ---
+    debug_log("Main thread waiting for worker threads to finish...\n");
+
+    // Join socket thread
+    if (pthread_join(socket_thread_id, NULL) != 0) {
+         perror("Error joining socket thread");
+    } else {
+         debug_log("Socket thread joined.\n");
+    }
+
+    // Join inertia thread first
+    if (pthread_join(inertia_thread_id, NULL) != 0) {
+         perror("Error joining inertia thread");
+    } else {
+         debug_log("Inertia thread joined.\n");
+    }
+
+    // Join input thread
+    if (pthread_join(input_thread_id, NULL) != 0) {
+         perror("Error joining input thread");
+    } else {
+         debug_log("Input thread joined.\n");
+    }
+
+    debug_log("All worker threads finished.\n");
+    // --- End Thread Joining ---
+    return 0;
+}
+
 int main(int argc, char *argv[]) {
     // Parse command line arguments first to get any config override and debug settings
     char *local_device_override = NULL;
@@ -215,6 +358,11 @@ int main(int argc, char *argv[]) {
             printf("  --debug                     Enable debug logging\n");
             printf("  --grab                      Grab the input device exclusively\n");
             printf("  --no-multitouch             Use wheel events instead of multitouch\n");
+            printf("  --backend=NAME              Select the output backend (");
+            list_emitter_backends(stdout);
+            printf(")\n");
+            printf("                              Overrides --no-multitouch\n");
+            printf("  --record-file=PATH          With --backend=record, also write frames to PATH\n");
             printf("  --natural                   Force natural scrolling direction\n");
             printf("  --traditional               Force traditional scrolling direction\n");
             printf("  --horizontal                Use horizontal scrolling instead of vertical\n");
@@ -229,8 +377,30 @@ int main(int argc, char *argv[]) {
             printf("                              Higher values reduce sensitivity for touchpads\n");
             printf("  --resolution-multiplier=VALUE Set resolution multiplier for virtual trackpad (default: 10.0)\n");
             printf("                              Higher values increase precision but may cause issues\n");
+            printf("  --touch-surface-factor=VALUE Set virtual touch surface size relative to the screen (1 to 64, default: 8.0)\n");
+            printf("                              Larger surfaces need fewer finger resets during long flings\n");
+            printf("  --no-touch-prearm           Touch down on the first motion instead of when the fling starts\n");
+            printf("  --touch-linger=MS           Keep the virtual contact MS milliseconds after a fling (default: 0)\n");
+            printf("                              Quick repeated flicks then continue the same gesture\n");
+            printf("  --single-thread             Serve input, frames and focus changes from one event loop\n");
+            printf("                              Avoids thread hand-offs on machines with few cores\n");
+            printf("  --emitter-thread            Write to the virtual devices from a dedicated thread\n");
+            printf("                              Keeps slow uinput writes out of the physics loop\n");
+            printf("  --sched=POLICY              Scheduling policy of the input and physics threads\n");
+            printf("                              (other, fifo or deadline; default: other)\n");
+            printf("  --sched-priority=VALUE      SCHED_FIFO priority (default: 10)\n");
+            printf("  --cpu-affinity=LIST         Run those threads on these CPUs only, e.g. 2-3\n");
+            printf("  --lock-memory               Lock the daemon's memory and prefault thread stacks\n");
+            printf("  --timer-slack=US            Timer slack of those threads in microseconds\n");
             printf("  --refresh-rate=VALUE         Set refresh rate in Hz for inertia updates (default: 200)\n");
             printf("                              Lower values reduce CPU usage but may feel less smooth\n");
+            printf("  --min-refresh-rate=VALUE    Lowest frame rate as a fling slows down (default: 30)\n");
+            printf("                              Set it to the refresh rate for a fixed frame rate\n");
+            printf("  --physics-rate=VALUE        Fixed physics steps per second (default: 1000)\n");
+            printf("  --no-display-sync           Do not lock frames to the display refresh\n");
+            printf("  --display-refresh=HZ        Display refresh rate to lock to (default: detected)\n");
+            printf("  --power-profile=MODE        auto, ac, battery or off (default: auto)\n");
+            printf("                              auto follows the power source with the ac_ and battery_ settings\n");
             printf("  --inertia-stop-threshold=VALUE Set velocity threshold below which inertia stops (default: 1.0)\n");
             printf("                              Higher values allow inertia to continue at lower speeds\n");
             printf("  --mouse-move-drag           Enable slowing down scrolling when mouse moves (default)\n");
@@ -351,6 +521,58 @@ int main(int argc, char *argv[]) {
                 fprintf(stderr, "Invalid resolution multiplier: %s\n", argv[i] + 24);
                 fprintf(stderr, "Using default resolution multiplier: 10.0\n");
             }
+        } else if (strncmp(argv[i], "--backend=", 10) == 0) {
+            free(backend_name);
+            backend_name = strdup(argv[i] + 10);
+        } else if (strncmp(argv[i], "--record-file=", 14) == 0) {
+            free(record_file_path);
+            record_file_path = strdup(argv[i] + 14);
+        } else if (strncmp(argv[i], "--touch-surface-factor=", 23) == 0) {
+            // Parse touch surface factor
+            double value = atof(argv[i] + 23);
+            if (value >= 1.0 && value <= MAX_TOUCH_SURFACE_FACTOR) {
+                touch_surface_factor = value;
+            } else {
+                fprintf(stderr, "Invalid touch surface factor: %s (use 1 to %.0f)\n", argv[i] + 23,
+                        MAX_TOUCH_SURFACE_FACTOR);
+                fprintf(stderr, "Using default touch surface factor: 8.0\n");
+            }
+        } else if (strcmp(argv[i], "--touch-prearm") == 0) {
+            touch_prearm = 1;
+        } else if (strcmp(argv[i], "--no-touch-prearm") == 0) {
+            touch_prearm = 0;
+        } else if (strncmp(argv[i], "--touch-linger=", 15) == 0) {
+            // Parse touch linger time
+            int value = atoi(argv[i] + 15);
+            if (value >= 0) {
+                touch_linger_ms = value;
+            } else {
+                fprintf(stderr, "Invalid touch linger time: %s\n", argv[i] + 15);
+                fprintf(stderr, "Using default touch linger time: 0\n");
+            }
+        } else if (strcmp(argv[i], "--single-thread") == 0) {
+            single_thread_mode = 1;
+        } else if (strcmp(argv[i], "--emitter-thread") == 0) {
+            use_emitter_thread = 1;
+        } else if (strncmp(argv[i], "--sched=", 8) == 0) {
+            free(sched_policy_name);
+            sched_policy_name = strdup(argv[i] + 8);
+        } else if (strncmp(argv[i], "--sched-priority=", 17) == 0) {
+            sched_priority = atoi(argv[i] + 17);
+        } else if (strncmp(argv[i], "--cpu-affinity=", 15) == 0) {
+            free(cpu_affinity);
+            cpu_affinity = strdup(argv[i] + 15);
+        } else if (strcmp(argv[i], "--lock-memory") == 0) {
+            lock_memory = 1;
+        } else if (strncmp(argv[i], "--timer-slack=", 14) == 0) {
+            // Parse timer slack
+            int value = atoi(argv[i] + 14);
+            if (value >= 0) {
+                timer_slack_us = value;
+            } else {
+                fprintf(stderr, "Invalid timer slack: %s\n", argv[i] + 14);
+                fprintf(stderr, "Using the kernel's default timer slack\n");
+            }
         } else if (strncmp(argv[i], "--refresh-rate=", 15) == 0) {
             // Parse refresh rate
             int value = atoi(argv[i] + 15);
@@ -360,6 +582,34 @@ int main(int argc, char *argv[]) {
                 fprintf(stderr, "Invalid refresh rate: %s\n", argv[i] + 15);
                 fprintf(stderr, "Using default refresh rate: 200\n");
             }
+        } else if (strncmp(argv[i], "--min-refresh-rate=", 19) == 0) {
+            int value = atoi(argv[i] + 19);
+            if (value > 0) {
+                min_refresh_rate = value;
+            } else {
+                fprintf(stderr, "Invalid minimum refresh rate: %s\n", argv[i] + 19);
+                fprintf(stderr, "Using default minimum refresh rate: 30\n");
+            }
+        } else if (strncmp(argv[i], "--physics-rate=", 15) == 0) {
+            int value = atoi(argv[i] + 15);
+            if (value > 0) {
+                physics_rate = value;
+            } else {
+                fprintf(stderr, "Invalid physics rate: %s\n", argv[i] + 15);
+                fprintf(stderr, "Using default physics rate: 1000\n");
+            }
+        } else if (strcmp(argv[i], "--no-display-sync") == 0) {
+            display_sync = 0;
+        } else if (strncmp(argv[i], "--display-refresh=", 18) == 0) {
+            double value = atof(argv[i] + 18);
+            if (value > 0.0) {
+                display_refresh_hz = value;
+            } else {
+                fprintf(stderr, "Invalid display refresh rate: %s\n", argv[i] + 18);
+                fprintf(stderr, "Detecting the display refresh rate instead\n");
+            }
+        } else if (strncmp(argv[i], "--power-profile=", 16) == 0) {
+            power_profile_mode = argv[i] + 16;
         } else if (strncmp(argv[i], "--inertia-stop-threshold=", 27) == 0) {
             // Parse inertia stop threshold
             double value = atof(argv[i] + 27);
@@ -395,7 +645,25 @@ int main(int argc, char *argv[]) {
     }
     
     
-    debug_log("Configuration: multitouch=%s, grab=%s, scroll_direction=%s, scroll_axis=%s, debug=%s\n", 
+    // Pick the output backend: an explicit name wins over the multitouch flag
+    const char *selected_backend = backend_name ? backend_name : (use_multitouch ? "multitouch" : "wheel");
+    emitter = find_emitter_backend(selected_backend);
+    if (!emitter) {
+        fprintf(stderr, "Unknown backend: %s\n", selected_backend);
+        fprintf(stderr, "Available backends: ");
+        list_emitter_backends(stderr);
+        fprintf(stderr, "\n");
+        return 1;
+    }
+    use_multitouch = (emitter == &multitouch_backend);
+    if (use_emitter_thread) {
+        emitter = threaded_emitter_backend(emitter);
+    }
+
+    debug_log("Configuration: backend=%s%s, threads=%s, multitouch=%s, grab=%s, scroll_direction=%s, scroll_axis=%s, debug=%s\n", 
+           emitter->name,
+           use_emitter_thread ? " (emitter thread)" : "",
+           single_thread_mode ? "single" : "input+inertia+socket",
            use_multitouch ? "enabled" : "disabled",
            grab_device ? "enabled" : "disabled",
            scroll_direction == SCROLL_DIRECTION_NATURAL ? "natural" : "traditional",
@@ -403,31 +671,59 @@ int main(int argc, char *argv[]) {
            debug_mode ? "enabled" : "disabled");
    debug_log("Sensitivity: %.2f, Multiplier: %.2f, Friction: %.2f, Divisor: %.2f\n",
           scroll_sensitivity, scroll_multiplier, scroll_friction, sensitivity_divisor);
-   debug_log("Max Velocity: %.2f, Refresh Rate: %d, Stop Threshold: %.2f\n",
-          max_velocity_factor, refresh_rate, inertia_stop_threshold);
+   debug_log("Max Velocity: %.2f, Refresh Rate: %d-%d, Stop Threshold: %.2f\n",
+          max_velocity_factor, min_refresh_rate, refresh_rate, inertia_stop_threshold);
 
-   // Initialize the virtual device based on the mode first
-    if (use_multitouch) {
-        if (setup_virtual_multitouch_device() < 0) {
-            fprintf(stderr, "Failed to set up virtual multitouch device.\n");
-            return 1;
-        }
-    } else {
-        if (setup_virtual_device() < 0) {
-            fprintf(stderr, "Failed to set up virtual device.\n");
-            return 1;
-        }
+    // Before any thread exists, so memory locking covers all of them
+    if (realtime_setup_process() < 0) {
+        return 1;
+    }
+
+    // --- Setup Signal Handling ---
+    // Before any thread exists (the emitter thread starts in setup()), so
+    // every thread inherits the blocked mask and only the signalfd sees
+    // SIGINT/SIGTERM
+    debug_log("Setting up shutdown signals...\n");
+    int signal_fd = open_signal_fd();
+    shutdown_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (signal_fd < 0 || shutdown_event_fd < 0) {
+        perror("Failed to set up shutdown signals");
+        return 1;
+    }
+    // --- End Signal Handling ---
+
+   // Initialize the virtual device of the selected backend first
+    if (emitter->setup() < 0) {
+        fprintf(stderr, "Failed to set up %s output device.\n", emitter->name);
+        return 1;
     }
     
+    // Frames are locked to the display from the first snapshot on
+    if (display_sync) {
+        detect_display_refresh();
+    }
+
+    // The power profile overrides the frame rate settings before the first
+    // snapshot; power_profile_handle() republishes when the source changes
+    if (power_profile_open() < 0) {
+        emitter->destroy();
+        return 1;
+    }
+
+    // Freeze the tunables now that the backend knows the screen size; from
+    // here on threads only read the published snapshot
+    if (config_publish() < 0) {
+        power_profile_close();
+        emitter->destroy();
+        return 1;
+    }
+
     // Then initialize input capture
     if (initialize_input_capture(device_override) < 0) {
         fprintf(stderr, "Failed to initialize input capture.\n");
         // Clean up the virtual device
-        if (use_multitouch) {
-            destroy_virtual_multitouch_device();
-        } else {
-            destroy_virtual_device();
-        }
+        power_profile_close();
+        emitter->destroy();
         return 1;
     }
     // --- Initialize Synchronization Primitives ---
@@ -447,96 +743,25 @@ int main(int argc, char *argv[]) {
     }
     // --- End Initialization ---
 
-    // --- Setup Signal Handling ---
-    // Signal handler function is now defined at file scope.
-    // We just need to register it here.
-
-    debug_log("Setting up signal handlers...\n");
-    struct sigaction sa;
-    memset(&sa, 0, sizeof(sa));
-    sa.sa_handler = handle_signal;
-    sigaction(SIGINT, &sa, NULL);  // Handle Ctrl+C
-    sigaction(SIGTERM, &sa, NULL); // Handle termination signals
-    // --- End Signal Handling ---
-
     debug_log("momentum mouse running. Scroll your mouse wheel!\n"); // Keep this log
 
-    // --- Create Threads ---
-    // Thread IDs
-    pthread_t input_thread_id;
-    pthread_t inertia_thread_id;
-
-    debug_log("Starting threads...\n");
-    if (pthread_create(&input_thread_id, NULL, input_thread_func, NULL) != 0) {
-        perror("Error creating input thread");
-        // Perform cleanup before exiting
-        cleanup_input_capture();
-        if (use_multitouch) destroy_virtual_multitouch_device(); else destroy_virtual_device();
-        pthread_mutex_destroy(&scroll_queue.mutex);
-        pthread_cond_destroy(&scroll_queue.cond);
-        pthread_mutex_destroy(&state_mutex);
-        pthread_cond_destroy(&state_cond);
-        return 1;
-    }
-    if (pthread_create(&inertia_thread_id, NULL, inertia_thread_func, NULL) != 0) {
-        perror("Error creating inertia thread");
-        // Signal input thread to stop, join it, perform cleanup
-        running = 0; // Signal input thread
-        debug_log("Waiting for input thread to exit after inertia thread creation failure...\n");
-        pthread_join(input_thread_id, NULL); // Wait for input thread to stop
-        cleanup_input_capture();
-        if (use_multitouch) destroy_virtual_multitouch_device(); else destroy_virtual_device();
-        pthread_mutex_destroy(&scroll_queue.mutex);
-        pthread_cond_destroy(&scroll_queue.cond);
-        pthread_mutex_destroy(&state_mutex);
-        pthread_cond_destroy(&state_cond);
-        return 1;
-    }
-    
-    // Start the unix socket thread
-    if (pthread_create(&socket_thread_id, NULL, socket_thread_func, NULL) != 0) {
-        perror("Warning: Error creating socket thread");
-        // We can continue running without the socket thread if necessary
-    }
-    
-    debug_log("Threads started successfully.\n");
-    // --- End Thread Creation ---
-
-    // --- Wait for Threads to Complete ---
-    debug_log("Main thread waiting for worker threads to finish...\n");
-
-    // Join socket thread
-    if (pthread_join(socket_thread_id, NULL) != 0) {
-         perror("Error joining socket thread");
-    } else {
-         debug_log("Socket thread joined.\n");
-    }
-
-    // Join inertia thread first
-    if (pthread_join(inertia_thread_id, NULL) != 0) {
-         perror("Error joining inertia thread");
-    } else {
-         debug_log("Inertia thread joined.\n");
-    }
-
-    // Join input thread
-    if (pthread_join(input_thread_id, NULL) != 0) {
-         perror("Error joining input thread");
-    } else {
-         debug_log("Input thread joined.\n");
+    int exit_code = 0;
+    if (single_thread_mode) {
+        debug_log("Running single-threaded event loop...\n");
+        if (run_event_loop(signal_fd) < 0) {
+            exit_code = 1;
+        }
+    } else if (run_worker_threads(signal_fd) < 0) {
+        exit_code = 1;
     }
 
-    debug_log("All worker threads finished.\n");
-    // --- End Thread Joining ---
 
     // --- Cleanup ---
     // The existing cleanup calls should remain after this block
+    emitter->destroy(); // Stops the emitter thread before the passthrough device goes
     cleanup_input_capture();
-    if (use_multitouch) {
-        destroy_virtual_multitouch_device();
-    } else {
-        destroy_virtual_device();
-    }
+    power_profile_close();
+    config_release();
     
     if (daemon_mode) {
         syslog(LOG_INFO, "momentum mouse daemon stopped");
@@ -549,7 +774,23 @@ int main(int argc, char *argv[]) {
     pthread_cond_destroy(&scroll_queue.cond);
     pthread_mutex_destroy(&state_mutex);
     pthread_cond_destroy(&state_cond);
+    close(signal_fd);
+    close(shutdown_event_fd);
+    shutdown_event_fd = -1;
     // --- End Cleanup ---
 
-    return 0;
+    if (debug_mode) {
+        realtime_report();
+    }
+
+    // Compare the threaded and single-thread modes by their own cost
+    struct rusage usage;
+    if (debug_mode && getrusage(RUSAGE_SELF, &usage) == 0) {
+        debug_log("CPU time: user %.1f ms, system %.1f ms; context switches: %ld voluntary, %ld involuntary\n",
+                  usage.ru_utime.tv_sec * 1000.0 + usage.ru_utime.tv_usec / 1000.0,
+                  usage.ru_stime.tv_sec * 1000.0 + usage.ru_stime.tv_usec / 1000.0,
+                  usage.ru_nvcsw, usage.ru_nivcsw);
+    }
+
+    return exit_code;
 }
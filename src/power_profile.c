@@ -0,0 +1,162 @@
+#include <libudev.h>
+#include <stdio.h>
+#include <string.h>
+#include "momentum_mouse.h"
+
+// AC and battery profiles. The power source is read from the power_supply
+// class in sysfs through udev, and a udev monitor reports plugging and
+// unplugging while the daemon runs. The active profile is written over the
+// staging globals and republished as a new config snapshot, so the threads
+// pick up the new frame rate on their next frame without a restart.
+
+char *power_profile_mode = NULL; // Set by --power-profile or the power_profile config key
+PowerProfile ac_profile = { -1, -1, -1 };
+PowerProfile battery_profile = { -1, -1, -1 };
+
+typedef enum {
+    POWER_UNKNOWN = 0,
+    POWER_AC,
+    POWER_BATTERY
+} PowerSource;
+
+static struct udev *power_udev = NULL;
+static struct udev_monitor *power_monitor = NULL;
+static PowerSource current_source = POWER_UNKNOWN;
+static PowerProfile base_profile; // The global settings before any profile
+
+static bool profile_is_set(const PowerProfile *p) {
+    return p->refresh_rate > 0 || p->min_refresh_rate > 0 || p->touch_linger_ms >= 0;
+}
+
+// On AC when any external supply is online, or when there is no system
+// battery at all (desktops). Batteries of wireless peripherals report
+// scope=Device and do not count.
+static PowerSource detect_power_source(void) {
+    struct udev_enumerate *enumerate = udev_enumerate_new(power_udev);
+    if (!enumerate) {
+        return POWER_UNKNOWN;
+    }
+    udev_enumerate_add_match_subsystem(enumerate, "power_supply");
+    udev_enumerate_scan_devices(enumerate);
+
+    bool has_battery = false;
+    bool external_online = false;
+    struct udev_list_entry *entry;
+    udev_list_entry_foreach(entry, udev_enumerate_get_list_entry(enumerate)) {
+        struct udev_device *dev = udev_device_new_from_syspath(power_udev, udev_list_entry_get_name(entry));
+        if (!dev) {
+            continue;
+        }
+        const char *type = udev_device_get_sysattr_value(dev, "type");
+        const char *scope = udev_device_get_sysattr_value(dev, "scope");
+        const char *online = udev_device_get_sysattr_value(dev, "online");
+        if (scope && strcmp(scope, "Device") == 0) {
+            // Mouse or keyboard battery
+        } else if (type && strcmp(type, "Battery") == 0) {
+            has_battery = true;
+        } else if (online && strcmp(online, "1") == 0) {
+            external_online = true; // Mains, USB, USB-C, ...
+        }
+        udev_device_unref(dev);
+    }
+    udev_enumerate_unref(enumerate);
+    return (external_online || !has_battery) ? POWER_AC : POWER_BATTERY;
+}
+
+// Write the profile for source over the globals (base values where the
+// profile has none)
+static void apply_profile(PowerSource source) {
+    const PowerProfile *p = source == POWER_BATTERY ? &battery_profile : &ac_profile;
+    refresh_rate = p->refresh_rate > 0 ? p->refresh_rate : base_profile.refresh_rate;
+    min_refresh_rate = p->min_refresh_rate > 0 ? p->min_refresh_rate : base_profile.min_refresh_rate;
+    touch_linger_ms = p->touch_linger_ms >= 0 ? p->touch_linger_ms : base_profile.touch_linger_ms;
+    current_source = source;
+    if (debug_mode) {
+        printf("Power: on %s, refresh rate %d-%d Hz, touch linger %d ms\n",
+               source == POWER_BATTERY ? "battery" : "AC", min_refresh_rate, refresh_rate, touch_linger_ms);
+    }
+}
+
+// Call before the first config_publish(); the first snapshot then already
+// carries the profile
+int power_profile_open(void) {
+    base_profile.refresh_rate = refresh_rate;
+    base_profile.min_refresh_rate = min_refresh_rate;
+    base_profile.touch_linger_ms = touch_linger_ms;
+
+    const char *mode = power_profile_mode ? power_profile_mode : "auto";
+    if (strcmp(mode, "off") == 0) {
+        return 0;
+    } else if (strcmp(mode, "ac") == 0) {
+        apply_profile(POWER_AC);
+        return 0;
+    } else if (strcmp(mode, "battery") == 0) {
+        apply_profile(POWER_BATTERY);
+        return 0;
+    } else if (strcmp(mode, "auto") != 0) {
+        fprintf(stderr, "Unknown power profile: %s (use auto, ac, battery or off)\n", mode);
+        return -1;
+    }
+
+    // Nothing to switch between
+    if (!profile_is_set(&ac_profile) && !profile_is_set(&battery_profile)) {
+        return 0;
+    }
+
+    power_udev = udev_new();
+    if (!power_udev) {
+        fprintf(stderr, "Warning: cannot create udev context, power profiles disabled\n");
+        return 0;
+    }
+    apply_profile(detect_power_source());
+
+    power_monitor = udev_monitor_new_from_netlink(power_udev, "udev");
+    if (!power_monitor ||
+        udev_monitor_filter_add_match_subsystem_devtype(power_monitor, "power_supply", NULL) < 0 ||
+        udev_monitor_enable_receiving(power_monitor) < 0) {
+        fprintf(stderr, "Warning: cannot watch power supplies, keeping the %s profile\n",
+                current_source == POWER_BATTERY ? "battery" : "AC");
+        if (power_monitor) {
+            udev_monitor_unref(power_monitor);
+            power_monitor = NULL;
+        }
+    }
+    return 0;
+}
+
+int power_profile_fd(void) {
+    return power_monitor ? udev_monitor_get_fd(power_monitor) : -1;
+}
+
+// Called from the main thread (threaded mode) or the event loop when the
+// monitor fd is readable. Several uevents arrive per plug, one per supply,
+// so the source is detected again instead of taken from the event.
+void power_profile_handle(void) {
+    if (!power_monitor) {
+        return;
+    }
+    struct udev_device *dev;
+    while ((dev = udev_monitor_receive_device(power_monitor)) != NULL) {
+        udev_device_unref(dev);
+    }
+    PowerSource source = detect_power_source();
+    if (source == current_source) {
+        return;
+    }
+    apply_profile(source);
+    if (config_publish() < 0) {
+        fprintf(stderr, "Warning: could not publish the %s profile\n",
+                source == POWER_BATTERY ? "battery" : "AC");
+    }
+}
+
+void power_profile_close(void) {
+    if (power_monitor) {
+        udev_monitor_unref(power_monitor);
+        power_monitor = NULL;
+    }
+    if (power_udev) {
+        udev_unref(power_udev);
+        power_udev = NULL;
+    }
+}
@@ -0,0 +1,238 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include "momentum_mouse.h"
+
+// Real-time options for the threads on the frame path: scheduling policy,
+// CPU affinity, page locking and timer slack. Everything here is optional
+// and best effort; without CAP_SYS_NICE/CAP_IPC_LOCK the daemon warns and
+// keeps running under the default policy.
+
+#ifndef SCHED_DEADLINE
+#define SCHED_DEADLINE 6
+#endif
+#ifndef MCL_ONFAULT
+#define MCL_ONFAULT 4
+#endif
+
+#define PREFAULT_STACK_BYTES (256 * 1024) // Stack each thread touches up front
+#define MIN_DEADLINE_RUNTIME_US 50
+
+char *sched_policy_name = NULL; // Set by --sched or the sched_policy config key
+int sched_priority = 10;
+char *cpu_affinity = NULL;
+int lock_memory = 0;
+int timer_slack_us = 0;
+DeadlineStats input_deadlines = {0};
+
+typedef enum {
+    POLICY_OTHER = 0,
+    POLICY_FIFO,
+    POLICY_DEADLINE
+} RealtimePolicy;
+
+static RealtimePolicy policy = POLICY_OTHER;
+static cpu_set_t affinity_set;
+static bool affinity_enabled = false;
+
+// Deadline reservation of the calling thread, for realtime_update_thread()
+static __thread const char *thread_role = NULL;
+static __thread long applied_period_us = 0;
+
+// Layout of the kernel's struct sched_attr (SCHED_ATTR_SIZE_VER0); newer C
+// libraries declare their own, so this one has a different name
+typedef struct {
+    uint32_t size;
+    uint32_t sched_policy;
+    uint64_t sched_flags;
+    int32_t sched_nice;
+    uint32_t sched_priority;
+    uint64_t sched_runtime;  // ns
+    uint64_t sched_deadline; // ns
+    uint64_t sched_period;   // ns
+} DeadlineAttr;
+
+static const char *policy_name(RealtimePolicy p) {
+    switch (p) {
+        case POLICY_FIFO: return "fifo";
+        case POLICY_DEADLINE: return "deadline";
+        default: return "other";
+    }
+}
+
+// Parse a CPU list such as "2", "0,2" or "4-7"
+static int parse_cpu_list(const char *list, cpu_set_t *set) {
+    CPU_ZERO(set);
+    const char *p = list;
+    while (*p) {
+        char *end;
+        long first = strtol(p, &end, 10);
+        long last = first;
+        if (end == p || first < 0) return -1;
+        if (*end == '-') {
+            p = end + 1;
+            last = strtol(p, &end, 10);
+            if (end == p || last < first) return -1;
+        }
+        if (last >= CPU_SETSIZE) return -1;
+        for (long cpu = first; cpu <= last; cpu++) {
+            CPU_SET(cpu, set);
+        }
+        if (*end == ',') {
+            end++;
+        } else if (*end != '\0') {
+            return -1;
+        }
+        p = end;
+    }
+    return CPU_COUNT(set) > 0 ? 0 : -1;
+}
+
+int realtime_setup_process(void) {
+    if (!sched_policy_name || strcmp(sched_policy_name, "other") == 0) {
+        policy = POLICY_OTHER;
+    } else if (strcmp(sched_policy_name, "fifo") == 0) {
+        policy = POLICY_FIFO;
+    } else if (strcmp(sched_policy_name, "deadline") == 0) {
+        policy = POLICY_DEADLINE;
+    } else {
+        fprintf(stderr, "Unknown scheduling policy: %s (use other, fifo or deadline)\n", sched_policy_name);
+        return -1;
+    }
+    if (policy == POLICY_FIFO &&
+        (sched_priority < sched_get_priority_min(SCHED_FIFO) || sched_priority > sched_get_priority_max(SCHED_FIFO))) {
+        fprintf(stderr, "Invalid SCHED_FIFO priority: %d\n", sched_priority);
+        return -1;
+    }
+
+    if (cpu_affinity) {
+        if (parse_cpu_list(cpu_affinity, &affinity_set) < 0) {
+            fprintf(stderr, "Invalid CPU list: %s\n", cpu_affinity);
+            return -1;
+        }
+        // The kernel only admits deadline tasks that may run on every CPU
+        // of their root domain
+        if (policy == POLICY_DEADLINE) {
+            fprintf(stderr, "Warning: cpu_affinity is ignored with the deadline policy\n");
+        } else {
+            affinity_enabled = true;
+        }
+    }
+
+    if (lock_memory) {
+        // Lock pages as they are touched instead of every thread's whole
+        // stack mapping; the stacks are prefaulted by each thread instead
+        if (mlockall(MCL_CURRENT | MCL_FUTURE | MCL_ONFAULT) < 0 &&
+            (errno != EINVAL || mlockall(MCL_CURRENT | MCL_FUTURE) < 0)) {
+            perror("Warning: mlockall failed");
+        } else {
+            // Keep freed heap memory mapped, and thus locked
+            mallopt(M_TRIM_THRESHOLD, -1);
+            mallopt(M_MMAP_MAX, 0);
+        }
+    }
+    return 0;
+}
+
+// Admit the calling thread as a SCHED_DEADLINE task; returns -1 if refused
+static int apply_deadline(const char *role, long period_us, long *runtime_us) {
+    if (*runtime_us < MIN_DEADLINE_RUNTIME_US) *runtime_us = MIN_DEADLINE_RUNTIME_US;
+    if (*runtime_us > period_us) *runtime_us = period_us;
+    DeadlineAttr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.sched_policy = SCHED_DEADLINE;
+    attr.sched_runtime = (uint64_t)*runtime_us * 1000;
+    attr.sched_deadline = (uint64_t)period_us * 1000;
+    attr.sched_period = (uint64_t)period_us * 1000;
+    if (syscall(__NR_sched_setattr, 0, &attr, 0) < 0) {
+        fprintf(stderr, "Warning: %s thread: SCHED_DEADLINE failed: %s\n", role, strerror(errno));
+        return -1;
+    }
+    thread_role = role;
+    applied_period_us = period_us;
+    return 0;
+}
+
+static void prefault_stack(void) {
+    volatile unsigned char stack[PREFAULT_STACK_BYTES];
+    for (size_t i = 0; i < sizeof(stack); i += 4096) {
+        stack[i] = 0;
+    }
+}
+
+// Apply the options to the calling thread. period_us is how often it has
+// work to do and runtime_us how much CPU time that work may take; both only
+// matter for the deadline policy.
+void realtime_setup_thread(const char *role, long period_us, long runtime_us) {
+    if (lock_memory) {
+        prefault_stack();
+    }
+    if (timer_slack_us > 0 && prctl(PR_SET_TIMERSLACK, (unsigned long)timer_slack_us * 1000UL, 0, 0, 0) < 0) {
+        fprintf(stderr, "Warning: %s thread: PR_SET_TIMERSLACK failed: %s\n", role, strerror(errno));
+    }
+    if (affinity_enabled) {
+        int rc = pthread_setaffinity_np(pthread_self(), sizeof(affinity_set), &affinity_set);
+        if (rc != 0) {
+            fprintf(stderr, "Warning: %s thread: setting CPU affinity failed: %s\n", role, strerror(rc));
+        }
+    }
+
+    if (policy == POLICY_FIFO) {
+        struct sched_param param = { .sched_priority = sched_priority };
+        int rc = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (rc != 0) {
+            fprintf(stderr, "Warning: %s thread: SCHED_FIFO failed: %s\n", role, strerror(rc));
+            return;
+        }
+    } else if (policy == POLICY_DEADLINE) {
+        if (apply_deadline(role, period_us, &runtime_us) < 0) {
+            return;
+        }
+    }
+    if (debug_mode) {
+        printf("%s thread: policy %s", role, policy_name(policy));
+        if (policy == POLICY_FIFO) printf(" priority %d", sched_priority);
+        if (policy == POLICY_DEADLINE) printf(" runtime %ld us period %ld us", runtime_us, period_us);
+        printf(", timer slack %d us, affinity %s\n", timer_slack_us, affinity_enabled ? cpu_affinity : "any");
+    }
+}
+
+// Called by the frame-paced threads on every pass with the current frame
+// period: a power profile switch republishes it, and the deadline
+// reservation has to follow. Does nothing unless the period changed.
+void realtime_update_thread(long period_us, long runtime_us) {
+    if (policy != POLICY_DEADLINE || !thread_role || period_us == applied_period_us) {
+        return;
+    }
+    if (apply_deadline(thread_role, period_us, &runtime_us) < 0) {
+        applied_period_us = period_us; // Warn once per change, not per pass
+        return;
+    }
+    if (debug_mode) {
+        printf("%s thread: deadline runtime %ld us period %ld us\n", thread_role, runtime_us, period_us);
+    }
+}
+
+static void print_deadline_stats(const char *what, const DeadlineStats *stats) {
+    printf("  %s: %lu of %lu missed (%.2f%%)\n", what, stats->missed, stats->checked,
+           stats->checked ? 100.0 * stats->missed / stats->checked : 0.0);
+}
+
+// Called once the threads have stopped
+void realtime_report(void) {
+    printf("Deadline misses under the %s policy%s:\n", policy_name(policy),
+           lock_memory ? " with locked memory" : "");
+    print_deadline_stats("frames started over half a period late", &frame_deadlines);
+    print_deadline_stats("wheel events handled over a period after the kernel stamped them", &input_deadlines);
+}
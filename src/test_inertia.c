@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
+#include <math.h>
 #include <time.h>
 #include <sys/time.h>
 #include <pthread.h> // Added
@@ -24,6 +25,35 @@ void end_multitouch_gesture(void) {
     printf("END GESTURE\n");
 }
 
+// Mock output backend: prints frames instead of writing to uinput
+static void mock_begin(void) {
+    printf("BEGIN GESTURE\n");
+}
+
+static int mock_frame(double velocity, double dt) {
+    printf("FRAME: velocity=%.2f dt=%.4f\n", velocity, dt);
+    return 0;
+}
+
+static int mock_passthrough(struct input_event *ev) {
+    (void)ev;
+    return 0;
+}
+
+static double mock_friction_coefficient(void) {
+    return 0.6 * scroll_friction;
+}
+
+static const EmitterBackend mock_backend = {
+    .name = "mock",
+    .begin = mock_begin,
+    .frame = mock_frame,
+    .end = end_multitouch_gesture,
+    .passthrough = mock_passthrough,
+    .friction_coefficient = mock_friction_coefficient,
+};
+const EmitterBackend *emitter = &mock_backend;
+
 // Mock implementation for function defined in event_emitter_mt.c
 void reset_finger_positions(void) {
     // Mock implementation - does nothing or logs
@@ -34,10 +64,6 @@ void reset_finger_positions(void) {
 // Global variables needed for testing (some are mocks for globals in momentum_mouse.c)
 int screen_width = 1920;
 int screen_height = 1080;
-int post_boundary_frames = 0;
-int boundary_reset_in_progress = 0;
-struct timeval last_boundary_reset_time = {0, 0};
-BoundaryResetInfo boundary_reset_info = {{0, 0}, 0.0, 0.0, 0};
 ScrollDirection scroll_direction = SCROLL_DIRECTION_TRADITIONAL;
 ScrollAxis scroll_axis = SCROLL_AXIS_VERTICAL;  // Default to vertical scrolling
 double scroll_sensitivity = 1.0;
@@ -52,13 +78,17 @@ pthread_mutex_t state_mutex;
 ScrollQueue scroll_queue; // Assumes ScrollQueue struct is defined via momentum_mouse.h
 pthread_cond_t state_cond; // Although not directly used by inertia_logic, it's in the header group
 volatile sig_atomic_t running = 1; // Initialize to 1 for tests
-bool stop_requested = false;
-int pending_friction_magnitude = 0;
+InertiaSignals inertia_signals = {0};
 int use_multitouch = 1; // Default to multitouch for testing relevant logic
 int grab_device = 0; // Not strictly needed by inertia_logic, but often related
 int auto_detect_direction = 0; // Not needed by inertia_logic
 char *device_override = NULL; // Not needed by inertia_logic
 int refresh_rate = 200; // Provide a default
+int min_refresh_rate = 30;
+int touch_linger_ms = 0;
+int display_sync = 1;
+int physics_rate = 1000;
+double display_refresh_hz = 0.0; // Free-running unless a test sets it
 double resolution_multiplier = 10.0; // Provide a default
 double inertia_stop_threshold = 1.0; // Provide a default
 // --- End Mock Global Variable Definitions ---
@@ -72,11 +102,11 @@ void test_direction_change(void) {
     stop_inertia();
     
     // Simulate scrolling up (negative delta in traditional mode)
-    printf("Simulating scroll up (delta=-1)...\n");
-    update_inertia(-1);
+    printf("Simulating scroll up (delta=-1 detent)...\n");
+    update_inertia(-WHEEL_HIRES_UNITS);
     
     // Print initial state
-    printf("Initial velocity: %.2f\n", current_velocity);
+    printf("Initial velocity: %.2f\n", inertia_state.velocity);
     
     // Simulate time passing and inertia processing
     printf("Processing inertia for 10 frames...\n");
@@ -84,16 +114,16 @@ void test_direction_change(void) {
     for (int i = 0; i < 10; i++) {
         process_inertia_mt();
         usleep(50000); // 50ms between frames
-        printf("Frame %d: velocity=%.2f, position=%.2f\n", i, current_velocity, current_position);
+        printf("Frame %d: velocity=%.2f, position=%.2f\n", i, inertia_state.velocity, inertia_state.position);
     }
     */
     
     // Now simulate scrolling in the opposite direction
-    printf("\nSimulating scroll down (delta=1) during inertia...\n");
-    update_inertia(1);
+    printf("\nSimulating scroll down (delta=1 detent) during inertia...\n");
+    update_inertia(WHEEL_HIRES_UNITS);
     
     // Print state after direction change
-    printf("Velocity after direction change: %.2f\n", current_velocity);
+    printf("Velocity after direction change: %.2f\n", inertia_state.velocity);
     
     // Continue processing inertia
     printf("Processing inertia for 10 more frames...\n");
@@ -101,7 +131,7 @@ void test_direction_change(void) {
     for (int i = 0; i < 10; i++) {
         process_inertia_mt();
         usleep(50000); // 50ms between frames
-        printf("Frame %d: velocity=%.2f, position=%.2f\n", i, current_velocity, current_position);
+        printf("Frame %d: velocity=%.2f, position=%.2f\n", i, inertia_state.velocity, inertia_state.position);
     }
     */
     
@@ -116,11 +146,11 @@ void test_mouse_movement_during_inertia(void) {
     stop_inertia();
     
     // Simulate scrolling
-    printf("Simulating scroll (delta=-1)...\n");
-    update_inertia(-1);
+    printf("Simulating scroll (delta=-1 detent)...\n");
+    update_inertia(-WHEEL_HIRES_UNITS);
     
     // Print initial state
-    printf("Initial velocity: %.2f\n", current_velocity);
+    printf("Initial velocity: %.2f\n", inertia_state.velocity);
     
     // Process inertia for a few frames
     printf("Processing inertia for 5 frames...\n");
@@ -128,7 +158,7 @@ void test_mouse_movement_during_inertia(void) {
     for (int i = 0; i < 5; i++) {
         process_inertia_mt();
         usleep(50000);
-        printf("Frame %d: velocity=%.2f, position=%.2f\n", i, current_velocity, current_position);
+        printf("Frame %d: velocity=%.2f, position=%.2f\n", i, inertia_state.velocity, inertia_state.position);
     }
     */
     
@@ -137,7 +167,7 @@ void test_mouse_movement_during_inertia(void) {
     apply_mouse_friction(10); // 10 pixels of movement
     
     // Print state after mouse movement
-    printf("Velocity after mouse movement: %.2f\n", current_velocity);
+    printf("Velocity after mouse movement: %.2f\n", inertia_state.velocity);
     
     // Continue processing inertia
     printf("Processing inertia for 5 more frames...\n");
@@ -145,7 +175,7 @@ void test_mouse_movement_during_inertia(void) {
     for (int i = 0; i < 5; i++) {
         process_inertia_mt();
         usleep(50000);
-        printf("Frame %d: velocity=%.2f, position=%.2f\n", i, current_velocity, current_position);
+        printf("Frame %d: velocity=%.2f, position=%.2f\n", i, inertia_state.velocity, inertia_state.position);
     }
     */
     
@@ -161,13 +191,14 @@ void test_mouse_movement_drag_disabled(void) {
     
     // Disable mouse move drag
     mouse_move_drag = 0;
+    config_publish();
     
     // Simulate scrolling
-    printf("Simulating scroll (delta=-1)...\n");
-    update_inertia(-1);
+    printf("Simulating scroll (delta=-1 detent)...\n");
+    update_inertia(-WHEEL_HIRES_UNITS);
     
     // Print initial state
-    printf("Initial velocity: %.2f\n", current_velocity);
+    printf("Initial velocity: %.2f\n", inertia_state.velocity);
     
     // Process inertia for a few frames
     printf("Processing inertia for 5 frames...\n");
@@ -175,7 +206,7 @@ void test_mouse_movement_drag_disabled(void) {
     for (int i = 0; i < 5; i++) {
         process_inertia_mt();
         usleep(50000);
-        printf("Frame %d: velocity=%.2f, position=%.2f\n", i, current_velocity, current_position);
+        printf("Frame %d: velocity=%.2f, position=%.2f\n", i, inertia_state.velocity, inertia_state.position);
     }
     */
     
@@ -184,7 +215,7 @@ void test_mouse_movement_drag_disabled(void) {
     apply_mouse_friction(10); // 10 pixels of movement
     
     // Print state after mouse movement
-    printf("Velocity after mouse movement: %.2f\n", current_velocity);
+    printf("Velocity after mouse movement: %.2f\n", inertia_state.velocity);
     
     // Continue processing inertia
     printf("Processing inertia for 5 more frames...\n");
@@ -192,16 +223,128 @@ void test_mouse_movement_drag_disabled(void) {
     for (int i = 0; i < 5; i++) {
         process_inertia_mt();
         usleep(50000);
-        printf("Frame %d: velocity=%.2f, position=%.2f\n", i, current_velocity, current_position);
+        printf("Frame %d: velocity=%.2f, position=%.2f\n", i, inertia_state.velocity, inertia_state.position);
     }
     */
     
     // Re-enable mouse move drag for other tests
     mouse_move_drag = 1;
+    config_publish();
     
     printf("Test completed.\n\n");
 }
 
+// Replay one fling with frames at a fixed rate; returns the distance covered
+// and stores the whole output steps the shared integrator emitted
+static double replay_fling(int rate, int *emitted) {
+    stop_inertia();
+    update_inertia(3 * WHEEL_HIRES_UNITS);
+    double start = inertia_state.position;
+
+    ScrollIntegrator integrator;
+    scroll_integrator_reset(&integrator);
+    double dt = 1.0 / rate;
+    int frames = 0;
+    *emitted = 0;
+    while (is_inertia_active() && frames < rate * 60) {
+        double distance = advance_inertia(dt);
+        *emitted += scroll_integrator_step(&integrator, distance / dt, dt, 1.0);
+        frames++;
+    }
+    printf("%4d Hz: %d frames, distance %.3f, emitted %d\n",
+           rate, frames, inertia_state.position - start, *emitted);
+    return inertia_state.position - start;
+}
+
+// The same fling must cover the same distance whatever the frame rate
+int test_frame_rate_independence(void) {
+    printf("=== TEST: Frame Rate Independence ===\n");
+    const int rates[] = {60, 200, 1000};
+    double distances[3];
+    int emitted[3];
+    for (int i = 0; i < 3; i++) {
+        distances[i] = replay_fling(rates[i], &emitted[i]);
+    }
+
+    int failed = 0;
+    for (int i = 0; i < 2; i++) {
+        double error = fabs(distances[i] - distances[2]);
+        if (error > 0.01 * fabs(distances[2]) || abs(emitted[i] - emitted[2]) > 1) {
+            printf("FAIL: %d Hz covers %.3f (%d steps), %d Hz covers %.3f (%d steps)\n",
+                   rates[i], distances[i], emitted[i], rates[2], distances[2], emitted[2]);
+            failed = 1;
+        }
+    }
+    printf("Test %s.\n\n", failed ? "FAILED" : "completed");
+    return failed;
+}
+
+// Start a fling with one detent, then add a second detent split into
+// events of units each; returns the velocity and stores the distance moved
+static double scroll_second_detent(int units, double *distance) {
+    stop_inertia();
+    double start = inertia_state.position;
+    update_inertia(WHEEL_HIRES_UNITS);
+    for (int sent = 0; sent < WHEEL_HIRES_UNITS; sent += units) {
+        update_inertia(units);
+    }
+    *distance = inertia_state.position - start;
+    printf("%3d-unit events: velocity %.3f, distance %.3f\n", units, inertia_state.velocity, *distance);
+    return inertia_state.velocity;
+}
+
+// A detent from a hi-res mouse (8 x 15 units) must push a fling exactly as
+// hard as one legacy detent (1 x 120)
+int test_hires_detent_equivalence(void) {
+    printf("=== TEST: Hi-res Detent Equivalence ===\n");
+    double hires_distance, legacy_distance;
+    double hires_velocity = scroll_second_detent(WHEEL_HIRES_UNITS / 8, &hires_distance);
+    double legacy_velocity = scroll_second_detent(WHEEL_HIRES_UNITS, &legacy_distance);
+
+    int failed = 0;
+    if (fabs(hires_velocity - legacy_velocity) > 1e-9 || fabs(hires_distance - legacy_distance) > 1e-9) {
+        printf("FAIL: 8 x 15 units give velocity %.3f, distance %.3f; 1 x 120 gives %.3f, %.3f\n",
+               hires_velocity, hires_distance, legacy_velocity, legacy_distance);
+        failed = 1;
+    }
+    printf("Test %s.\n\n", failed ? "FAILED" : "completed");
+    return failed;
+}
+
+// Half a detent left over from one fling must not complete a tick of the
+// next one, whether the fling was stopped or the wheel rested in between
+int test_hires_remainder_reset(void) {
+    printf("=== TEST: Hi-res Remainder Reset ===\n");
+    int failed = 0;
+
+    stop_inertia();
+    update_inertia(WHEEL_HIRES_UNITS / 2);
+    stop_inertia();
+    update_inertia(WHEEL_HIRES_UNITS / 2);
+    if (is_inertia_active()) {
+        printf("FAIL: half a detent carried across stop_inertia()\n");
+        failed = 1;
+    }
+
+    stop_inertia();
+    update_inertia(WHEEL_HIRES_UNITS / 2);
+    usleep(350000); // Longer than the consecutive-scroll window
+    update_inertia(WHEEL_HIRES_UNITS / 2);
+    if (is_inertia_active()) {
+        printf("FAIL: half a detent carried across a 350 ms rest\n");
+        failed = 1;
+    }
+
+    update_inertia(WHEEL_HIRES_UNITS / 2);
+    if (!is_inertia_active()) {
+        printf("FAIL: two quick half detents did not start a fling\n");
+        failed = 1;
+    }
+    stop_inertia();
+    printf("Test %s.\n\n", failed ? "FAILED" : "completed");
+    return failed;
+}
+
 int main(void) {
     // Seed random number generator
     srand(time(NULL));
@@ -222,19 +365,26 @@ int main(void) {
     }
     // Initialize scroll queue fields
     memset(&scroll_queue, 0, sizeof(scroll_queue));
+    if (config_publish() < 0) {
+        return 1;
+    }
     // --- End Initialization ---
 
     // Run tests
     test_direction_change();
     test_mouse_movement_during_inertia();
     test_mouse_movement_drag_disabled();
+    int failed = test_frame_rate_independence();
+    failed |= test_hires_detent_equivalence();
+    failed |= test_hires_remainder_reset();
 
     // --- Cleanup Mocks ---
     printf("Destroying mock mutexes and cond vars...\n");
     pthread_mutex_destroy(&state_mutex);
     pthread_mutex_destroy(&scroll_queue.mutex);
     pthread_cond_destroy(&scroll_queue.cond);
+    config_release();
     // --- End Cleanup ---
 
-    return 0;
+    return failed;
 }
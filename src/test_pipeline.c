@@ -0,0 +1,1025 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include "momentum_mouse.h"
+
+// End-to-end run of the inertia thread against the record backend.
+// Needs neither root nor /dev/uinput.
+
+// Mocks for symbols of the full application
+static atomic_int passthrough_calls = 0;
+static atomic_bool passthrough_hold = false; // Stalls the writer, as a backed-up device would
+static int passthrough_last_type = EV_SYN;
+static int passthrough_torn = 0;            // Events that did not continue a whole frame
+
+int emit_passthrough_event(struct input_event *ev) {
+    passthrough_calls++;
+    // Every frame the tests send is one event followed by its SYN_REPORT
+    if ((ev->type == EV_SYN) == (passthrough_last_type == EV_SYN)) {
+        passthrough_torn++;
+    }
+    passthrough_last_type = ev->type;
+    while (atomic_load(&passthrough_hold)) {
+        usleep(100);
+    }
+    return 0;
+}
+
+int flush_passthrough_events(void) {
+    return 0;
+}
+
+const EmitterBackend *emitter = &record_backend;
+
+// Global variables needed by inertia_logic.c and event_emitter_mt.c
+ScrollDirection scroll_direction = SCROLL_DIRECTION_TRADITIONAL;
+ScrollAxis scroll_axis = SCROLL_AXIS_VERTICAL;
+double scroll_sensitivity = 1.0;
+double scroll_multiplier = 1.0;
+double scroll_friction = 2.0;
+double max_velocity_factor = 0.8;
+double sensitivity_divisor = 1.0;
+int debug_mode = 0;
+int mouse_move_drag = 1;
+pthread_mutex_t state_mutex;
+ScrollQueue scroll_queue;
+pthread_cond_t state_cond;
+volatile sig_atomic_t running = 1;
+InertiaSignals inertia_signals = {0};
+int use_multitouch = 1;
+int grab_device = 0;
+int auto_detect_direction = 0;
+char *device_override = NULL;
+int refresh_rate = 200;
+int min_refresh_rate = 30;
+int touch_linger_ms = 0;
+int display_sync = 1;
+int physics_rate = 1000;
+double display_refresh_hz = 0.0; // Free-running unless a test sets it
+double resolution_multiplier = 10.0;
+double touch_surface_factor = 8.0;
+int touch_prearm = 1;
+double inertia_stop_threshold = 1.0;
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        printf("FAIL: " __VA_ARGS__); \
+        printf("\n"); \
+        failures++; \
+    } \
+} while (0)
+
+static void enqueue_at(int delta, double when) {
+    pthread_mutex_lock(&scroll_queue.mutex);
+    scroll_queue.deltas[scroll_queue.head] = delta;
+    scroll_queue.enqueue_times[scroll_queue.head] = when;
+    scroll_queue.head = (scroll_queue.head + 1) % SCROLL_QUEUE_SIZE;
+    scroll_queue.count++;
+    pthread_cond_signal(&scroll_queue.cond);
+    pthread_mutex_unlock(&scroll_queue.mutex);
+}
+
+static void enqueue(int delta) {
+    enqueue_at(delta, engine_clock_now());
+}
+
+static bool wait_for_inertia_to_stop(int timeout_ms) {
+    for (int waited = 0; waited < timeout_ms; waited += 10) {
+        usleep(10000);
+        if (!is_inertia_active()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void stop_inertia_thread(pthread_t thread) {
+    running = 0;
+    pthread_mutex_lock(&scroll_queue.mutex);
+    pthread_cond_signal(&scroll_queue.cond);
+    pthread_mutex_unlock(&scroll_queue.mutex);
+    pthread_join(thread, NULL);
+}
+
+// A short burst of wheel ticks must produce begin, decaying frames, end
+void test_fling_is_recorded(const char *record_path) {
+    printf("=== TEST: Fling Recorded Headless ===\n");
+    record_file_path = (char *)record_path;
+    CHECK(emitter->setup() == 0, "record backend setup failed");
+
+    running = 1;
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, inertia_thread_func, NULL) != 0) {
+        perror("Error creating inertia thread");
+        failures++;
+        return;
+    }
+
+    for (int i = 0; i < 3; i++) {
+        enqueue(WHEEL_HIRES_UNITS);
+        usleep(15000);
+    }
+    CHECK(wait_for_inertia_to_stop(10000), "inertia did not stop within 10s");
+    stop_inertia_thread(thread);
+    emitter->destroy();
+
+    size_t count = record_frame_count();
+    printf("Recorded %zu frames\n", count);
+    CHECK(count >= 3, "expected at least begin/frame/end, got %zu", count);
+    CHECK(record_overwritten_frames() == 0, "ring overflowed");
+    if (count < 3) {
+        return;
+    }
+
+    CHECK(record_get_frame(0)->kind == RECORD_BEGIN, "first record is not begin");
+    CHECK(record_get_frame(count - 1)->kind == RECORD_END, "last record is not end");
+
+    size_t frames = 0;
+    double last_tail_speed = INFINITY;
+    for (size_t i = 1; i < count; i++) {
+        const RecordedFrame *prev = record_get_frame(i - 1);
+        const RecordedFrame *cur = record_get_frame(i);
+        CHECK(cur->time >= prev->time, "timestamps go backwards at %zu", i);
+        if (cur->kind == RECORD_FRAME) {
+            frames++;
+            CHECK(cur->dt >= 0.0, "negative dt at %zu", i);
+            // All ticks are positive, so velocity must stay positive
+            CHECK(cur->velocity > 0.0, "velocity changed sign at %zu (%.2f)", i, cur->velocity);
+            // After the last tick only friction acts, so speed must not grow
+            if (cur->time > prev->time && i > count / 2) {
+                CHECK(fabs(cur->velocity) <= last_tail_speed + 1e-9, "speed grew during decay at %zu", i);
+                last_tail_speed = fabs(cur->velocity);
+            }
+        }
+    }
+    CHECK(frames >= 1, "no motion frames recorded");
+
+    // The first tick must not wait for a sleep or a frame period to pass
+    printf("First frame latency: %.3f ms\n", first_frame_latency.last * 1000.0);
+    CHECK(first_frame_latency.count == 1, "expected one fling, got %lu", first_frame_latency.count);
+    CHECK(first_frame_latency.max < 0.010, "first frame took %.3f ms", first_frame_latency.max * 1000.0);
+    CHECK(record_get_frame(1)->kind == RECORD_FRAME, "first fling cycle emitted no motion");
+
+    // The file must hold the same frames as the ring, after a header line
+    FILE *fp = fopen(record_path, "r");
+    CHECK(fp != NULL, "record file missing");
+    if (fp) {
+        char line[256];
+        size_t lines = 0;
+        while (fgets(line, sizeof(line), fp)) {
+            if (line[0] != '#') lines++;
+        }
+        fclose(fp);
+        CHECK(lines == count, "record file has %zu frames, ring has %zu", lines, count);
+    }
+    record_file_path = NULL;
+}
+
+// The same fling through the emitter thread: every command arrives, in
+// order, and passthrough events reach the inner backend
+void test_fling_through_emitter_thread(void) {
+    printf("=== TEST: Fling Through Emitter Thread ===\n");
+    const EmitterBackend *direct = emitter;
+    emitter = threaded_emitter_backend(&record_backend);
+    record_reset();
+    passthrough_calls = 0;
+    CHECK(emitter->setup() == 0, "threaded record backend setup failed");
+
+    running = 1;
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, inertia_thread_func, NULL) != 0) {
+        perror("Error creating inertia thread");
+        failures++;
+        emitter->destroy();
+        emitter = direct;
+        return;
+    }
+
+    struct input_event ev[2];
+    memset(ev, 0, sizeof(ev));
+    ev[0].type = EV_KEY;
+    ev[0].code = BTN_LEFT;
+    ev[1].type = EV_SYN;
+    ev[1].code = SYN_REPORT;
+    for (int i = 0; i < 3; i++) {
+        emitter->passthrough(&ev[0]);
+        emitter->passthrough(&ev[1]);
+    }
+    CHECK(emitter->flush() == 0, "input thread was left with pending frames");
+
+    for (int i = 0; i < 3; i++) {
+        enqueue(WHEEL_HIRES_UNITS);
+        usleep(15000);
+    }
+    CHECK(wait_for_inertia_to_stop(10000), "inertia did not stop within 10s");
+    stop_inertia_thread(thread);
+    emitter->destroy();
+    emitter = direct;
+
+    size_t count = record_frame_count();
+    printf("Recorded %zu frames\n", count);
+    CHECK(count >= 3, "expected at least begin/frame/end, got %zu", count);
+    CHECK(passthrough_calls == 6, "expected 6 passthrough events, got %d", passthrough_calls);
+    if (count < 3) {
+        return;
+    }
+    CHECK(record_get_frame(0)->kind == RECORD_BEGIN, "first record is not begin");
+    CHECK(record_get_frame(count - 1)->kind == RECORD_END, "last record is not end");
+    for (size_t i = 1; i + 1 < count; i++) {
+        CHECK(record_get_frame(i)->kind == RECORD_FRAME, "record %zu is not a frame", i);
+    }
+}
+
+// The daemon sets the backend up before the first config_publish(), so
+// the emitter thread must run, and pass events through, with no snapshot
+void test_emitter_thread_before_first_snapshot(void) {
+    printf("=== TEST: Emitter Thread Before First Snapshot ===\n");
+    CHECK(config_read_lock() == NULL, "a snapshot was already published");
+    config_read_unlock();
+    const EmitterBackend *direct = emitter;
+    emitter = threaded_emitter_backend(&record_backend);
+    passthrough_calls = 0;
+    CHECK(emitter->setup() == 0, "threaded record backend setup failed");
+
+    struct input_event ev[2];
+    memset(ev, 0, sizeof(ev));
+    ev[0].type = EV_KEY;
+    ev[0].code = BTN_LEFT;
+    ev[1].type = EV_SYN;
+    ev[1].code = SYN_REPORT;
+    emitter->passthrough(&ev[0]);
+    emitter->passthrough(&ev[1]);
+    CHECK(emitter->flush() == 0, "input thread was left with pending frames");
+    for (int waited_ms = 0; passthrough_calls < 2 && waited_ms < 1000; waited_ms++) {
+        usleep(1000);
+    }
+    emitter->destroy();
+    emitter = direct;
+    CHECK(passthrough_calls == 2, "expected 2 passthrough events, got %d", passthrough_calls);
+}
+
+// With the emitter thread stalled, the passthrough ring fills up; motion
+// frames beyond it are dropped whole and every frame written is complete
+void test_passthrough_ring_keeps_frames_whole(void) {
+    printf("=== TEST: Passthrough Ring Full ===\n");
+    const EmitterBackend *direct = emitter;
+    emitter = threaded_emitter_backend(&record_backend);
+    passthrough_calls = 0;
+    passthrough_torn = 0;
+    passthrough_last_type = EV_SYN;
+    CHECK(emitter->setup() == 0, "threaded record backend setup failed");
+
+    const int frames = 1000;
+    struct input_event ev[2];
+    memset(ev, 0, sizeof(ev));
+    ev[0].type = EV_REL;
+    ev[0].code = REL_X;
+    ev[1].type = EV_SYN;
+    ev[1].code = SYN_REPORT;
+
+    // Park the emitter thread inside the first write
+    atomic_store(&passthrough_hold, true);
+    emitter->passthrough(&ev[0]);
+    emitter->passthrough(&ev[1]);
+    emitter->flush();
+    for (int waited_ms = 0; passthrough_calls == 0 && waited_ms < 1000; waited_ms++) {
+        usleep(1000);
+    }
+
+    int rejected = 0;
+    for (int i = 1; i < frames; i++) {
+        ev[0].value = i;
+        emitter->passthrough(&ev[0]);
+        if (emitter->passthrough(&ev[1]) < 0) {
+            rejected++;
+        }
+    }
+    atomic_store(&passthrough_hold, false);
+    emitter->flush();
+    emitter->destroy();
+    emitter = direct;
+
+    int delivered = passthrough_calls / 2;
+    printf("Delivered %d frames, dropped %d\n", delivered, rejected);
+    CHECK(rejected > 0, "ring never filled up");
+    CHECK(delivered + rejected == frames, "%d frames delivered, %d dropped, %d sent",
+          delivered, rejected, frames);
+    CHECK(passthrough_torn == 0, "%d events out of frame", passthrough_torn);
+}
+
+// --- Seqlock snapshot ---
+// A reader polling the snapshot during a fling must never see a torn state
+
+static atomic_bool snapshot_reader_done;
+static unsigned long snapshot_reads = 0;
+static unsigned long snapshot_torn = 0;
+
+static void* snapshot_reader_func(void* arg) {
+    (void)arg;
+    unsigned long last_frames = 0;
+    while (!snapshot_reader_done) {
+        InertiaSnapshot snap;
+        inertia_snapshot(&snap);
+        snapshot_reads++;
+        // stop_inertia() clears the flag and the velocity together
+        if ((!snap.active && snap.velocity != 0.0) || snap.frames < last_frames) {
+            snapshot_torn++;
+        }
+        last_frames = snap.frames;
+    }
+    return NULL;
+}
+
+void test_snapshot_is_consistent(void) {
+    printf("=== TEST: Seqlock Snapshot ===\n");
+    record_reset();
+    CHECK(emitter->setup() == 0, "record backend setup failed");
+    InertiaSnapshot before;
+    inertia_snapshot(&before);
+
+    running = 1;
+    snapshot_reader_done = false;
+    pthread_t thread, reader;
+    if (pthread_create(&thread, NULL, inertia_thread_func, NULL) != 0 ||
+        pthread_create(&reader, NULL, snapshot_reader_func, NULL) != 0) {
+        perror("Error creating test threads");
+        failures++;
+        return;
+    }
+    for (int i = 0; i < 3; i++) {
+        enqueue(WHEEL_HIRES_UNITS);
+        usleep(15000);
+    }
+    CHECK(wait_for_inertia_to_stop(10000), "inertia did not stop within 10s");
+    stop_inertia_thread(thread);
+    snapshot_reader_done = true;
+    pthread_join(reader, NULL);
+    emitter->destroy();
+
+    InertiaSnapshot after;
+    inertia_snapshot(&after);
+    printf("%lu snapshots read, %lu physics frames\n", snapshot_reads, after.frames - before.frames);
+    CHECK(snapshot_reads > 0, "reader never ran");
+    CHECK(snapshot_torn == 0, "%lu torn snapshots", snapshot_torn);
+    CHECK(!after.active && after.velocity == 0.0, "fling still active after stop");
+    CHECK(after.flings == before.flings + 1, "expected one new fling, got %lu", after.flings - before.flings);
+    CHECK(after.frames > before.frames, "no physics frames counted");
+}
+
+static atomic_bool config_reader_done;
+static atomic_ulong config_reads;
+static unsigned long config_mismatches = 0;
+
+static void* config_reader_func(void* arg) {
+    (void)arg;
+    while (!config_reader_done) {
+        const ConfigSnapshot *cfg = config_read_lock();
+        // Derived constants must belong to the snapshot they came with;
+        // a freed or half-built snapshot breaks the relation
+        double expected = 60.0 * cfg->sensitivity_scale;
+        for (int spin = 0; spin < 100; spin++) {
+            if (cfg->tick_velocity != expected ||
+                cfg->tick_distance != POSITION_UNITS_PER_DETENT * cfg->sensitivity_scale) {
+                config_mismatches++;
+                break;
+            }
+        }
+        config_read_unlock();
+        config_reads++;
+    }
+    return NULL;
+}
+
+// Publishing must never pull a snapshot out from under a reader
+void test_config_republished_under_readers(void) {
+    printf("=== TEST: Config Snapshot Republish ===\n");
+    double saved_sensitivity = scroll_sensitivity;
+    int saved_debug = debug_mode;
+    debug_mode = 0;
+    config_reader_done = false;
+
+    pthread_t readers[2];
+    for (int i = 0; i < 2; i++) {
+        if (pthread_create(&readers[i], NULL, config_reader_func, NULL) != 0) {
+            perror("Error creating config reader");
+            failures++;
+            return;
+        }
+    }
+    for (int waited = 0; config_reads == 0 && waited < 1000; waited++) {
+        usleep(1000);
+    }
+    int publishes = 0;
+    for (int i = 0; i < 200; i++) {
+        scroll_sensitivity = 0.5 + (i % 10) * 0.25;
+        if (config_publish() == 0) {
+            publishes++;
+        }
+        usleep(100);
+    }
+    config_reader_done = true;
+    for (int i = 0; i < 2; i++) {
+        pthread_join(readers[i], NULL);
+    }
+
+    scroll_sensitivity = saved_sensitivity;
+    config_publish();
+    debug_mode = saved_debug;
+    const ConfigSnapshot *cfg = config_read_lock();
+    printf("%d snapshots published, %lu read sections\n", publishes, (unsigned long)config_reads);
+    CHECK(publishes == 200, "only %d of 200 publishes succeeded", publishes);
+    CHECK(config_reads > 0, "readers never ran");
+    CHECK(config_mismatches == 0, "%lu inconsistent snapshots", config_mismatches);
+    CHECK(cfg->tick_velocity == 60.0 * scroll_sensitivity / sensitivity_divisor,
+          "final snapshot has stale tick velocity %.2f", cfg->tick_velocity);
+    config_read_unlock();
+}
+
+// Single-thread mode drives the engine with inertia_cycle() from its own
+// loop; the result must match the inertia thread's
+void test_fling_driven_inline(void) {
+    printf("=== TEST: Fling Driven Inline ===\n");
+    record_reset();
+    CHECK(emitter->setup() == 0, "record backend setup failed");
+    inertia_engine_start();
+
+    for (int i = 0; i < 3; i++) {
+        enqueue(WHEEL_HIRES_UNITS);
+        inertia_cycle(false);
+        usleep(15000);
+    }
+    int cycles = 0;
+    while (is_inertia_active() && cycles < 10000) {
+        usleep(1000000 / refresh_rate);
+        inertia_cycle(true);
+        cycles++;
+    }
+    CHECK(!is_inertia_active(), "inertia did not stop after %d cycles", cycles);
+    inertia_engine_stop();
+    emitter->destroy();
+
+    size_t count = record_frame_count();
+    printf("Recorded %zu frames\n", count);
+    CHECK(count >= 3, "expected at least begin/frame/end, got %zu", count);
+    if (count < 3) {
+        return;
+    }
+    CHECK(record_get_frame(0)->kind == RECORD_BEGIN, "first record is not begin");
+    CHECK(record_get_frame(1)->kind == RECORD_FRAME, "first cycle emitted no motion");
+    CHECK(record_get_frame(count - 1)->kind == RECORD_END, "last record is not end");
+}
+
+// Run one fling inline, sleeping inertia_frame_interval_us() between cycles
+// like the event loop does; every LATE_WAKEUP_EVERY-th wake-up oversleeps
+// by late_us. Returns the number of frame cycles; distance gets the
+// distance the recorded frames carry
+#define LATE_WAKEUP_EVERY 8
+
+static int run_paced_fling(double *distance, long late_us) {
+    record_reset();
+    CHECK(emitter->setup() == 0, "record backend setup failed");
+    inertia_engine_start();
+
+    for (int i = 0; i < 3; i++) {
+        enqueue(WHEEL_HIRES_UNITS);
+        inertia_cycle(false);
+        usleep(15000);
+    }
+    int cycles = 0;
+    while (is_inertia_active() && cycles < 10000) {
+        usleep(inertia_frame_interval_us() + (cycles % LATE_WAKEUP_EVERY == LATE_WAKEUP_EVERY - 1 ? late_us : 0));
+        inertia_cycle(true);
+        cycles++;
+    }
+    CHECK(!is_inertia_active(), "inertia did not stop after %d cycles", cycles);
+    inertia_engine_stop();
+    emitter->destroy();
+
+    *distance = 0.0;
+    for (size_t i = 0; i < record_frame_count(); i++) {
+        const RecordedFrame *frame = record_get_frame(i);
+        if (frame->kind == RECORD_FRAME) {
+            *distance += frame->velocity * frame->dt;
+        }
+    }
+    return cycles;
+}
+
+// As a fling slows, frames stretch towards min_refresh_rate and passes that
+// would not move the output are held back; the fling must still cover the
+// same distance as at a fixed rate
+void test_frame_rate_adapts_to_velocity(void) {
+    printf("=== TEST: Frame Rate Adapts To Velocity ===\n");
+    int saved_min_rate = min_refresh_rate;
+    double fixed_distance, adaptive_distance;
+
+    min_refresh_rate = refresh_rate;
+    config_publish();
+    int fixed_cycles = run_paced_fling(&fixed_distance, 0);
+
+    min_refresh_rate = 20;
+    config_publish();
+    int adaptive_cycles = run_paced_fling(&adaptive_distance, 0);
+
+    printf("Fixed rate %d cycles over %.2f, adaptive rate %d cycles over %.2f\n",
+           fixed_cycles, fixed_distance, adaptive_cycles, adaptive_distance);
+    CHECK(adaptive_cycles < fixed_cycles, "adaptive pacing did not save wake-ups (%d vs %d)",
+          adaptive_cycles, fixed_cycles);
+    CHECK(fabs(adaptive_distance - fixed_distance) < 0.05 * fabs(fixed_distance),
+          "adaptive fling covered %.2f instead of %.2f", adaptive_distance, fixed_distance);
+
+    min_refresh_rate = saved_min_rate;
+    config_publish();
+}
+
+// A click stops a fling at once even when the slow tail has stretched the
+// frame interval to a second: the request wakes the inertia thread
+void test_stop_wakes_slow_fling(void) {
+    printf("=== TEST: Stop Wakes Slow Fling ===\n");
+    int saved_min_rate = min_refresh_rate;
+    min_refresh_rate = 1;
+    config_publish();
+    CHECK(emitter->setup() == 0, "record backend setup failed");
+
+    running = 1;
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, inertia_thread_func, NULL) != 0) {
+        perror("Error creating inertia thread");
+        failures++;
+        min_refresh_rate = saved_min_rate;
+        config_publish();
+        return;
+    }
+
+    // Wait for the tail, where frames are a quarter second or more apart
+    enqueue(WHEEL_HIRES_UNITS);
+    InertiaSnapshot state;
+    do {
+        usleep(1000);
+        inertia_snapshot(&state);
+    } while (state.active && fabs(state.velocity) > 4.0);
+    CHECK(state.active, "fling ended before reaching its slow tail");
+
+    pthread_mutex_lock(&state_mutex);
+    inertia_signals.stop_requested = true;
+    pthread_mutex_unlock(&state_mutex);
+    wake_inertia_thread();
+    double start = engine_clock_now();
+    while (is_inertia_active() && engine_clock_now() - start < 2.0) {
+        usleep(100);
+    }
+    double waited_ms = (engine_clock_now() - start) * 1000.0;
+    printf("Stop seen after %.2f ms\n", waited_ms);
+    CHECK(!is_inertia_active(), "fling did not stop");
+    CHECK(waited_ms < 50.0, "stop waited %.1f ms for the next frame", waited_ms);
+
+    stop_inertia_thread(thread);
+    emitter->destroy();
+    min_refresh_rate = saved_min_rate;
+    config_publish();
+}
+
+// With a known display refresh the frame rate snaps to a multiple of it and
+// motion frames go out on the display-locked slots
+void test_frames_locked_to_display(void) {
+    printf("=== TEST: Frames Locked To Display ===\n");
+    int saved_min_rate = min_refresh_rate;
+
+    display_refresh_hz = 60.0;
+    config_publish();
+    const ConfigSnapshot *cfg = config_read_lock();
+    CHECK(cfg->refresh_rate == 180, "200 Hz on a 60 Hz display ran at %d Hz", cfg->refresh_rate);
+    config_read_unlock();
+
+    // The lock never raises the frame rate above refresh_rate
+    int saved_rate = refresh_rate;
+    refresh_rate = 30;
+    config_publish();
+    cfg = config_read_lock();
+    CHECK(cfg->refresh_rate == 30, "30 Hz on a 60 Hz display ran at %d Hz", cfg->refresh_rate);
+    config_read_unlock();
+    display_refresh_hz = 144.0;
+    config_publish();
+    cfg = config_read_lock();
+    CHECK(cfg->refresh_rate <= 30 && fabs(cfg->frame_phase_period - 5.0 / 144.0) < 1e-12,
+          "30 Hz on a 144 Hz display ran at %d Hz", cfg->refresh_rate);
+    config_read_unlock();
+    refresh_rate = 288;
+    config_publish();
+    cfg = config_read_lock();
+    CHECK(cfg->refresh_rate == 288, "288 Hz on a 144 Hz display ran at %d Hz", cfg->refresh_rate);
+    config_read_unlock();
+    refresh_rate = 250;
+    config_publish();
+    cfg = config_read_lock();
+    CHECK(cfg->refresh_rate == 144, "250 Hz on a 144 Hz display ran at %d Hz", cfg->refresh_rate);
+    config_read_unlock();
+    refresh_rate = saved_rate;
+
+    display_refresh_hz = 144.0;
+    min_refresh_rate = 20;
+    config_publish();
+    cfg = config_read_lock();
+    double period = cfg->frame_phase_period;
+    CHECK(cfg->refresh_rate == 144, "200 Hz on a 144 Hz display ran at %d Hz", cfg->refresh_rate);
+    CHECK(fabs(period - 1.0 / 144.0) < 1e-12, "frame slots %.6f s apart", period);
+    double max_slots = cfg->max_frame_period_us / (period * 1000000.0);
+    CHECK(fabs(max_slots - round(max_slots)) < 0.01,
+          "longest frame interval %ld us is not whole slots", cfg->max_frame_period_us);
+    config_read_unlock();
+
+    memset(&frame_phase_error, 0, sizeof(frame_phase_error));
+    memset(&frame_slots, 0, sizeof(frame_slots));
+    double distance;
+    run_paced_fling(&distance, 0);
+    printf("%lu frames, phase error mean %.3f ms, max %.3f ms (slot %.3f ms), %lu slots missed\n",
+           frame_phase_error.count,
+           frame_phase_error.count ? frame_phase_error.total / frame_phase_error.count * 1000.0 : 0.0,
+           frame_phase_error.max * 1000.0, period * 1000.0, frame_slots.missed);
+    CHECK(frame_phase_error.count > 0, "no phase error samples");
+    CHECK(frame_phase_error.count == 0 || frame_phase_error.total / frame_phase_error.count < period / 4.0,
+          "frames drift off their slots");
+
+    // Wake-ups one and a half slots late must show up as missed slots, not
+    // pass as frames on the following slot
+    memset(&frame_phase_error, 0, sizeof(frame_phase_error));
+    memset(&frame_slots, 0, sizeof(frame_slots));
+    long late_us = (long)(1.5 * period * 1000000.0);
+    int cycles = run_paced_fling(&distance, late_us);
+    unsigned long late_wakeups = cycles / LATE_WAKEUP_EVERY;
+    printf("%lu late wake-ups: %lu of %lu slots missed, phase error max %.3f ms\n",
+           late_wakeups, frame_slots.missed, frame_slots.checked, frame_phase_error.max * 1000.0);
+    CHECK(late_wakeups > 0, "fling too short to inject a late wake-up");
+    // A late pass in the slow tail may have no whole step to emit, so not
+    // every late wake-up produces a measured frame
+    CHECK(frame_slots.missed >= late_wakeups / 2, "%lu late wake-ups, only %lu slots counted as missed",
+          late_wakeups, frame_slots.missed);
+    CHECK(frame_phase_error.max >= period, "late frames measured %.3f ms off their slot",
+          frame_phase_error.max * 1000.0);
+
+    display_refresh_hz = 0.0;
+    min_refresh_rate = saved_min_rate;
+    config_publish();
+}
+
+// Replay the same three ticks, queued 15 ms apart, and drive the fling with
+// up to max_jitter_us of extra delay on every wake-up. A fourth tick is
+// stamped MID_FLING_TICK_OFFSET after the first and wakes the engine like
+// input does, so jitter decides how late the engine sees it. Returns the
+// distance the recorded frames carry; steps gets the physics steps the
+// fling took.
+#define MID_FLING_TICK_OFFSET 0.200
+
+static double run_jittered_fling(int max_jitter_us, unsigned long *steps) {
+    unsigned seed = 1;
+    record_reset();
+    CHECK(emitter->setup() == 0, "record backend setup failed");
+    inertia_engine_start();
+
+    InertiaSnapshot before, after;
+    inertia_snapshot(&before);
+    double fling_start = engine_clock_now() - 0.030;
+    for (int i = 0; i < 3; i++) {
+        enqueue_at(WHEEL_HIRES_UNITS, fling_start + i * 0.015);
+    }
+    double mid_tick_at = fling_start + MID_FLING_TICK_OFFSET;
+    bool mid_tick_queued = false;
+    inertia_cycle(false);
+    int cycles = 0;
+    while (is_inertia_active() && cycles < 10000) {
+        long wait_us = inertia_frame_interval_us();
+        bool tick_due = false;
+        if (!mid_tick_queued) {
+            long until_tick_us = (long)((mid_tick_at - engine_clock_now()) * 1000000.0);
+            if (until_tick_us < wait_us) {
+                wait_us = until_tick_us > 0 ? until_tick_us : 0;
+                tick_due = true;
+            }
+        }
+        usleep(wait_us + (max_jitter_us ? rand_r(&seed) % max_jitter_us : 0));
+        if (tick_due) {
+            enqueue_at(WHEEL_HIRES_UNITS, mid_tick_at);
+            mid_tick_queued = true;
+        }
+        inertia_cycle(!tick_due);
+        cycles++;
+    }
+    CHECK(mid_tick_queued, "fling ended before the mid-fling tick");
+    CHECK(!is_inertia_active(), "inertia did not stop after %d cycles", cycles);
+    inertia_engine_stop();
+    emitter->destroy();
+    inertia_snapshot(&after);
+
+    *steps = after.frames - before.frames;
+    double distance = 0.0;
+    for (size_t i = 0; i < record_frame_count(); i++) {
+        const RecordedFrame *frame = record_get_frame(i);
+        if (frame->kind == RECORD_FRAME) {
+            distance += frame->velocity * frame->dt;
+        }
+    }
+    return distance;
+}
+
+// Physics runs in fixed steps and frames sample it, so late wake-ups must
+// not change the fling itself
+void test_fling_independent_of_jitter(void) {
+    printf("=== TEST: Fling Independent Of Wake-up Jitter ===\n");
+    unsigned long steady_steps, jittered_steps;
+    double steady = run_jittered_fling(0, &steady_steps);
+    double jittered = run_jittered_fling(8000, &jittered_steps);
+    printf("Steady: %.6f over %lu steps, jittered: %.6f over %lu steps\n",
+           steady, steady_steps, jittered, jittered_steps);
+    CHECK(steady_steps == jittered_steps, "fling took %lu steps with jitter instead of %lu",
+          jittered_steps, steady_steps);
+    CHECK(fabs(steady - jittered) < 1e-6, "jitter changed the distance from %.6f to %.6f", steady, jittered);
+}
+
+// --- Outbox under backpressure ---
+// A non-blocking pipe stands in for a uinput fd that returns EAGAIN
+
+static int backed_up_pipe(int fds[2]) {
+    if (pipe(fds) < 0) {
+        perror("pipe");
+        return -1;
+    }
+    fcntl(fds[1], F_SETFL, O_NONBLOCK);
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    // Fill it with EV_MSC filler until the writer would block
+    struct input_event filler;
+    memset(&filler, 0, sizeof(filler));
+    filler.type = EV_MSC;
+    while (write(fds[1], &filler, sizeof(filler)) == (ssize_t)sizeof(filler)) {
+    }
+    return 0;
+}
+
+// Read everything left in the pipe, skipping the filler
+static int drain_pipe(int fd, struct input_event *out, int max) {
+    struct input_event ev;
+    int count = 0;
+    while (read(fd, &ev, sizeof(ev)) == (ssize_t)sizeof(ev)) {
+        if (ev.type != EV_MSC && count < max) {
+            out[count++] = ev;
+        }
+    }
+    return count;
+}
+
+static int send_event(UinputOutbox *box, int type, int code, int value, OutboxFrameClass cls) {
+    struct input_event frame[2];
+    memset(frame, 0, sizeof(frame));
+    frame[0].type = type;
+    frame[0].code = code;
+    frame[0].value = value;
+    frame[1].type = EV_SYN;
+    frame[1].code = SYN_REPORT;
+    return outbox_send(box, frame, 2, cls);
+}
+
+// Scroll coalesces while blocked, the button frame is kept and in order
+void test_outbox_coalesces_and_keeps_order(void) {
+    printf("=== TEST: Outbox Coalescing ===\n");
+    int fds[2];
+    if (backed_up_pipe(fds) < 0) {
+        failures++;
+        return;
+    }
+    UinputOutbox box;
+    outbox_init(&box, "test", fds[1]);
+
+    for (int i = 0; i < 10; i++) {
+        CHECK(send_event(&box, EV_REL, REL_WHEEL, 1, OUTBOX_COALESCE) == 0, "wheel frame %d rejected", i);
+    }
+    CHECK(send_event(&box, EV_KEY, BTN_LEFT, 1, OUTBOX_ESSENTIAL) == 0, "button frame rejected");
+    CHECK(outbox_pending(&box) == 2, "expected 2 pending frames, got %d", outbox_pending(&box));
+    CHECK(box.coalesced == 9, "expected 9 coalesced frames, got %lu", box.coalesced);
+
+    struct input_event got[64];
+    int n = drain_pipe(fds[0], got, 64);
+    CHECK(n == 0, "frames leaked while blocked");
+    CHECK(outbox_flush(&box) == 0, "outbox not drained after the reader caught up");
+    n = drain_pipe(fds[0], got, 64);
+    CHECK(n == 4, "expected 4 events, got %d", n);
+    if (n == 4) {
+        CHECK(got[0].type == EV_REL && got[0].value == 10, "wheel total %d, expected 10", got[0].value);
+        CHECK(got[1].type == EV_SYN, "wheel frame not terminated");
+        CHECK(got[2].type == EV_KEY && got[2].code == BTN_LEFT, "button frame missing or out of order");
+        CHECK(got[3].type == EV_SYN, "button frame not terminated");
+    }
+    CHECK(box.dropped == 0, "dropped %lu frames", box.dropped);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+// A full queue sheds motion, never the button press and release
+void test_outbox_full_keeps_essential_frames(void) {
+    printf("=== TEST: Outbox Full ===\n");
+    int fds[2];
+    if (backed_up_pipe(fds) < 0) {
+        failures++;
+        return;
+    }
+    UinputOutbox box;
+    outbox_init(&box, "test", fds[1]);
+
+    send_event(&box, EV_KEY, BTN_LEFT, 1, OUTBOX_ESSENTIAL);
+    for (int i = 1; i <= 40; i++) {
+        send_event(&box, EV_REL, REL_X, i, OUTBOX_DROPPABLE);
+    }
+    send_event(&box, EV_KEY, BTN_LEFT, 0, OUTBOX_ESSENTIAL);
+    printf("Dropped %lu motion frames\n", box.dropped);
+    CHECK(box.dropped == 10, "expected 10 dropped frames, got %lu", box.dropped);
+    CHECK(outbox_pending(&box) == OUTBOX_FRAMES_MAX, "queue holds %d frames", outbox_pending(&box));
+
+    struct input_event got[128];
+    drain_pipe(fds[0], got, 128);
+    CHECK(outbox_flush(&box) == 0, "outbox not drained");
+    int n = drain_pipe(fds[0], got, 128);
+    CHECK(n == OUTBOX_FRAMES_MAX * 2, "expected %d events, got %d", OUTBOX_FRAMES_MAX * 2, n);
+    if (n == OUTBOX_FRAMES_MAX * 2) {
+        CHECK(got[0].type == EV_KEY && got[0].value == 1, "button press lost");
+        CHECK(got[2].type == EV_REL && got[2].value == 11, "oldest motion not dropped first (got %d)", got[2].value);
+        CHECK(got[n - 2].type == EV_KEY && got[n - 2].value == 0, "button release lost");
+    }
+    close(fds[0]);
+    close(fds[1]);
+}
+
+// A queue full of button frames turns the next one away at once instead of
+// stalling the caller until the reader catches up
+void test_outbox_never_waits(void) {
+    printf("=== TEST: Outbox Never Waits ===\n");
+    int fds[2];
+    if (backed_up_pipe(fds) < 0) {
+        failures++;
+        return;
+    }
+    UinputOutbox box;
+    outbox_init(&box, "test", fds[1]);
+
+    for (int i = 0; i < OUTBOX_FRAMES_MAX; i++) {
+        CHECK(send_event(&box, EV_KEY, BTN_LEFT, !(i & 1), OUTBOX_ESSENTIAL) == 0, "button frame %d rejected", i);
+    }
+    double start = engine_clock_now();
+    int rc = send_event(&box, EV_KEY, BTN_RIGHT, 1, OUTBOX_ESSENTIAL);
+    double elapsed_ms = (engine_clock_now() - start) * 1000.0;
+    printf("Full queue answered in %.3f ms\n", elapsed_ms);
+    CHECK(rc < 0, "frame accepted into a full queue");
+    CHECK(elapsed_ms < 5.0, "caller blocked for %.1f ms", elapsed_ms);
+    CHECK(box.essential_dropped == 1, "expected 1 essential drop, got %lu", box.essential_dropped);
+
+    // The queued frames still go out, whole and in order
+    struct input_event got[128];
+    drain_pipe(fds[0], got, 128);
+    CHECK(outbox_flush(&box) == 0, "outbox not drained");
+    int n = drain_pipe(fds[0], got, 128);
+    CHECK(n == OUTBOX_FRAMES_MAX * 2, "expected %d events, got %d", OUTBOX_FRAMES_MAX * 2, n);
+    if (n == OUTBOX_FRAMES_MAX * 2) {
+        CHECK(got[0].value == 1 && got[n - 2].value == 0, "button frames out of order");
+    }
+    close(fds[0]);
+    close(fds[1]);
+}
+
+// Drive the multitouch encoder into a pipe and decode it the way the
+// compositor does: each frame moves by the average motion of the contacts
+// that stayed down across it. A pair rotation moves nothing by itself.
+static double multitouch_run_travel(int frames, int delta, int *touch_downs) {
+    *touch_downs = 0;
+    int fds[2];
+    if (pipe(fds) < 0) {
+        perror("pipe");
+        return NAN;
+    }
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    fcntl(fds[1], F_SETFL, O_NONBLOCK);
+    while (multitouch_gesture_gap_remaining_ms() > 0) {
+        usleep(1000);
+    }
+    attach_multitouch_encoder(fds[1]);
+    for (int i = 0; i < frames; i++) {
+        emit_two_finger_scroll_event(delta);
+    }
+    end_multitouch_gesture();
+
+    int id[4] = {-1, -1, -1, -1}, y[4] = {0};
+    int prev_id[4] = {-1, -1, -1, -1}, prev_y[4] = {0};
+    int slot = 0;
+    double travel = 0.0;
+    struct input_event ev;
+    while (read(fds[0], &ev, sizeof(ev)) == (ssize_t)sizeof(ev)) {
+        if (ev.type == EV_ABS && ev.code == ABS_MT_SLOT) {
+            slot = (ev.value >= 0 && ev.value < 4) ? ev.value : 0;
+        } else if (ev.type == EV_ABS && ev.code == ABS_MT_TRACKING_ID) {
+            id[slot] = ev.value;
+            if (ev.value >= 0) {
+                (*touch_downs)++;
+            }
+        } else if (ev.type == EV_ABS && ev.code == ABS_MT_POSITION_Y) {
+            y[slot] = ev.value;
+        } else if (ev.type == EV_SYN && ev.code == SYN_REPORT) {
+            int held = 0;
+            double moved = 0.0;
+            for (int s = 0; s < 4; s++) {
+                if (id[s] >= 0 && id[s] == prev_id[s]) {
+                    moved += y[s] - prev_y[s];
+                    held++;
+                }
+                prev_id[s] = id[s];
+                prev_y[s] = y[s];
+            }
+            if (held > 0) {
+                travel += moved / held;
+            }
+        }
+    }
+    close(fds[0]);
+    close(fds[1]);
+    return travel;
+}
+
+// A fling that crosses the surface edge travels exactly as far as one that
+// stays inside it: the rotation frame's motion is replayed, not lost
+void test_boundary_rotation_keeps_travel(void) {
+    printf("=== TEST: Boundary Rotation Keeps Travel ===\n");
+    const int frames = 200, delta = 7;
+    int inside_downs, crossing_downs;
+
+    touch_surface_factor = 8.0;
+    double inside = multitouch_run_travel(frames, delta, &inside_downs);
+    touch_surface_factor = 1.0; // Surface as tall as the screen, crossed once
+    double crossing = multitouch_run_travel(frames, delta, &crossing_downs);
+    touch_surface_factor = 8.0;
+
+    printf("Inside: %.1f units, %d contacts; crossing: %.1f units, %d contacts\n",
+           inside, inside_downs, crossing, crossing_downs);
+    CHECK(inside_downs == 2, "fling inside the surface rotated (%d contacts)", inside_downs);
+    CHECK(crossing_downs > 2, "fling never crossed the surface edge");
+    CHECK(inside == frames * delta, "expected %d units inside, got %.1f", frames * delta, inside);
+    CHECK(crossing == inside, "crossing lost motion: %.1f vs %.1f units", crossing, inside);
+}
+
+int main(void) {
+    if (pthread_mutex_init(&state_mutex, NULL) != 0 ||
+        pthread_cond_init(&state_cond, NULL) != 0) {
+        perror("Mock state init failed");
+        return 1;
+    }
+    memset(&scroll_queue, 0, sizeof(scroll_queue));
+    if (pthread_mutex_init(&scroll_queue.mutex, NULL) != 0 ||
+        pthread_cond_init(&scroll_queue.cond, NULL) != 0) {
+        perror("Mock scroll queue init failed");
+        return 1;
+    }
+    test_emitter_thread_before_first_snapshot();
+    if (config_publish() < 0) {
+        return 1;
+    }
+
+    char record_path[] = "/tmp/momentum_record_XXXXXX";
+    int fd = mkstemp(record_path);
+    if (fd < 0) {
+        perror("mkstemp");
+        return 1;
+    }
+    close(fd);
+
+    test_fling_is_recorded(record_path);
+    unlink(record_path);
+    test_fling_through_emitter_thread();
+    test_passthrough_ring_keeps_frames_whole();
+    test_fling_driven_inline();
+    test_frame_rate_adapts_to_velocity();
+    test_stop_wakes_slow_fling();
+    test_frames_locked_to_display();
+    test_fling_independent_of_jitter();
+    test_snapshot_is_consistent();
+    test_config_republished_under_readers();
+    test_outbox_coalesces_and_keeps_order();
+    test_outbox_full_keeps_essential_frames();
+    test_outbox_never_waits();
+    test_boundary_rotation_keeps_travel();
+
+    pthread_cond_destroy(&scroll_queue.cond);
+    pthread_mutex_destroy(&scroll_queue.mutex);
+    pthread_cond_destroy(&state_cond);
+    pthread_mutex_destroy(&state_mutex);
+    config_release();
+
+    if (failures) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("All pipeline tests passed.\n");
+    return 0;
+}
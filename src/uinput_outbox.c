@@ -0,0 +1,181 @@
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "momentum_mouse.h"
+
+// Outbound frame queue for a non-blocking uinput fd. A frame that cannot be
+// written (EAGAIN or a short write) is kept and retried as a whole, so the
+// compositor never sees half a frame. Pending scroll motion with the same
+// layout is merged instead of queued, and when the queue is full the oldest
+// motion frame is dropped; gesture-end, touch-down and button frames are
+// never dropped while the device is still accepting writes. No call ever
+// waits for the device, so the inertia thread and the event loop keep
+// their frame timing while the compositor is backed up.
+
+void outbox_init(UinputOutbox *box, const char *name, int fd) {
+    memset(box, 0, sizeof(*box));
+    box->name = name;
+    box->fd = fd;
+}
+
+int outbox_pending(const UinputOutbox *box) {
+    return box->frame_count;
+}
+
+// Remove frame i and its events, keeping the rest in order
+static void outbox_remove(UinputOutbox *box, int i) {
+    OutboxFrame *frame = &box->frames[i];
+    int start = frame->start;
+    int count = frame->count;
+    memmove(&box->events[start], &box->events[start + count],
+            (box->event_count - start - count) * sizeof(struct input_event));
+    box->event_count -= count;
+    memmove(&box->frames[i], &box->frames[i + 1],
+            (box->frame_count - i - 1) * sizeof(OutboxFrame));
+    box->frame_count--;
+    for (int j = i; j < box->frame_count; j++) {
+        box->frames[j].start -= count;
+    }
+}
+
+// Drop the oldest frame that is neither essential nor partly written
+static bool outbox_drop_oldest(UinputOutbox *box) {
+    for (int i = 0; i < box->frame_count; i++) {
+        if (box->frames[i].cls != OUTBOX_ESSENTIAL && box->frames[i].written == 0) {
+            outbox_remove(box, i);
+            box->dropped++;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Merge a scroll frame into the last queued one if both carry the same
+// events in the same order: relative values add up, absolute values and
+// keys take the newer value
+static bool outbox_coalesce(UinputOutbox *box, const struct input_event *events, int count) {
+    if (box->frame_count == 0) {
+        return false;
+    }
+    OutboxFrame *last = &box->frames[box->frame_count - 1];
+    if (last->cls != OUTBOX_COALESCE || last->written != 0 || last->count != count) {
+        return false;
+    }
+    struct input_event *queued = &box->events[last->start];
+    for (int i = 0; i < count; i++) {
+        if (queued[i].type != events[i].type || queued[i].code != events[i].code) {
+            return false;
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        if (events[i].type == EV_REL) {
+            queued[i].value += events[i].value;
+        } else if (events[i].type != EV_SYN) {
+            queued[i].value = events[i].value;
+        }
+    }
+    box->coalesced++;
+    return true;
+}
+
+int outbox_flush(UinputOutbox *box) {
+    while (box->frame_count > 0) {
+        OutboxFrame *frame = &box->frames[0];
+        int remaining = frame->count - frame->written;
+        ssize_t len = (ssize_t)(remaining * sizeof(struct input_event));
+        ssize_t written = write(box->fd, &box->events[frame->start + frame->written], len);
+        if (written < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+                box->retries++;
+                return box->frame_count;
+            }
+            if (debug_mode) {
+                fprintf(stderr, "%s: write failed, discarding %d queued frame(s): %s\n",
+                        box->name, box->frame_count, strerror(errno));
+            }
+            box->dropped += box->frame_count;
+            box->frame_count = 0;
+            box->event_count = 0;
+            return -1;
+        }
+        frame->written += (int)(written / (ssize_t)sizeof(struct input_event));
+        if (frame->written < frame->count) {
+            box->retries++;
+            return box->frame_count;
+        }
+        outbox_remove(box, 0);
+    }
+    return 0;
+}
+
+int outbox_queue(UinputOutbox *box, const struct input_event *events, int count,
+                 int already_written, OutboxFrameClass cls) {
+    if (count > OUTBOX_EVENTS_MAX) {
+        box->dropped++;
+        return -1;
+    }
+    if (already_written == 0 && cls == OUTBOX_COALESCE && outbox_coalesce(box, events, count)) {
+        return 0;
+    }
+
+    // Make room by dropping stale motion. Nothing here waits for the
+    // device: the frame is queued and goes out with the next flush, idle
+    // pass or frame. Only a queue holding nothing but essential frames
+    // turns one away.
+    while (box->frame_count == OUTBOX_FRAMES_MAX || box->event_count + count > OUTBOX_EVENTS_MAX) {
+        if (outbox_drop_oldest(box)) {
+            continue;
+        }
+        box->dropped++;
+        if (cls == OUTBOX_ESSENTIAL || already_written > 0) {
+            box->essential_dropped++;
+            if (debug_mode) {
+                fprintf(stderr, "%s: queue full of essential frames, dropping one\n", box->name);
+            }
+        }
+        return -1;
+    }
+
+    OutboxFrame *frame = &box->frames[box->frame_count++];
+    frame->start = box->event_count;
+    frame->count = count;
+    frame->written = already_written;
+    frame->cls = cls;
+    memcpy(&box->events[box->event_count], events, count * sizeof(struct input_event));
+    box->event_count += count;
+    return 0;
+}
+
+int outbox_send(UinputOutbox *box, const struct input_event *events, int count, OutboxFrameClass cls) {
+    if (box->frame_count > 0) {
+        // Keep ordering: queue behind what is pending, then try to drain
+        if (outbox_queue(box, events, count, 0, cls) < 0) {
+            return -1;
+        }
+        return outbox_flush(box) < 0 ? -1 : 0;
+    }
+
+    ssize_t len = (ssize_t)(count * sizeof(struct input_event));
+    ssize_t written = write(box->fd, events, len);
+    if (written == len) {
+        return 0;
+    }
+    if (written < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        if (debug_mode) {
+            fprintf(stderr, "%s: write failed: %s\n", box->name, strerror(errno));
+        }
+        box->dropped++;
+        return -1;
+    }
+    box->retries++;
+    int done = written > 0 ? (int)(written / (ssize_t)sizeof(struct input_event)) : 0;
+    return outbox_queue(box, events, count, done, cls);
+}
+
+void outbox_report(const UinputOutbox *box) {
+    if (box->retries || box->dropped || box->coalesced) {
+        printf("%s: %lu retries, %lu dropped (%lu essential), %lu coalesced\n",
+               box->name, box->retries, box->dropped, box->essential_dropped, box->coalesced);
+    }
+}